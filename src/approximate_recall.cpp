@@ -0,0 +1,51 @@
+#include "approximate_recall.h"
+
+#include <algorithm>
+
+std::ostream& operator<<(std::ostream& os, const RecallReport& report) {
+    return os << "queries = " << report.query_count
+    		<< ", recall = " << report.recall
+    		<< ", estimated recall = " << report.estimated_recall
+    		<< ", scored postings = " << report.scored_postings << " of " << report.total_postings
+    		<< ", exact = " << report.exact_duration.count() << " us"
+    		<< ", approximate = " << report.approximate_duration.count() << " us";
+}
+
+RecallReport EvaluateApproximateRecall(const SegmentedSearchServer& search_server, const std::vector<std::string>& queries,
+		const ApproximateQueryOptions& options) {
+    using Clock = std::chrono::steady_clock;
+    RecallReport report;
+    Clock::duration exact_duration{};
+    Clock::duration approximate_duration{};
+    for (const std::string& query : queries) {
+    	const auto exact_start = Clock::now();
+    	const std::vector<Document> exact = search_server.FindTopDocuments(query);
+    	const auto approximate_start = Clock::now();
+    	const ApproximateDocuments approximate = search_server.FindTopDocumentsApproximate(query, options);
+    	approximate_duration += Clock::now() - approximate_start;
+    	exact_duration += approximate_start - exact_start;
+    	if (exact.empty()) {
+    		continue;
+    	}
+
+    	const size_t found = std::count_if(exact.begin(), exact.end(), [&approximate](const Document& document) {
+    		return std::any_of(approximate.documents.begin(), approximate.documents.end(), [&document](const Document& other) {
+    			return other.id == document.id;
+    		});
+    	});
+    	++report.query_count;
+    	report.recall += found * 1.0 / exact.size();
+    	report.estimated_recall += approximate.estimated_recall;
+    	report.scored_postings += approximate.scored_postings;
+    	report.total_postings += approximate.total_postings;
+    }
+    if (report.query_count > 0) {
+    	report.recall /= report.query_count;
+    	report.estimated_recall /= report.query_count;
+    	report.scored_postings /= report.query_count;
+    	report.total_postings /= report.query_count;
+    }
+    report.exact_duration = std::chrono::duration_cast<std::chrono::microseconds>(exact_duration);
+    report.approximate_duration = std::chrono::duration_cast<std::chrono::microseconds>(approximate_duration);
+    return report;
+}
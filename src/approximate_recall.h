@@ -0,0 +1,28 @@
+#pragma once
+
+#include "segmented_search_server.h"
+
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Quality and cost of approximate queries against the exact ones on the same index
+struct RecallReport {
+    // queries with a non-empty exact result, the others cannot lose documents
+    size_t query_count = 0;
+    // mean share of the exact top documents returned by the approximate query
+    double recall = 0.0;
+    double estimated_recall = 0.0;
+    double scored_postings = 0.0;
+    double total_postings = 0.0;
+    std::chrono::microseconds exact_duration{0};
+    std::chrono::microseconds approximate_duration{0};
+};
+
+std::ostream& operator<<(std::ostream& os, const RecallReport& report);
+
+// Measures recall@MAX_RESULT_DOCUMENT_COUNT of FindTopDocumentsApproximate, comparing documents by id
+RecallReport EvaluateApproximateRecall(const SegmentedSearchServer& search_server, const std::vector<std::string>& queries,
+		const ApproximateQueryOptions& options);
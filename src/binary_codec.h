@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+// Fixed-width fields in host byte order and byte strings prefixed by a uint32_t length,
+// shared by the index log records and the search protocol frames
+
+template <typename T>
+void Put(std::string& out, const T& value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+inline void PutBytes(std::string& out, std::string_view bytes) {
+    Put(out, static_cast<uint32_t>(bytes.size()));
+    out.append(bytes);
+}
+
+// Reads fields back in the order they were put; throws std::runtime_error with truncated_message
+// when data ends before a field does
+class BinaryReader {
+public:
+    BinaryReader(std::string_view data, const char* truncated_message)
+    	: data_(data)
+    	, truncated_message_(truncated_message)
+    {
+    }
+
+    template <typename T>
+    T Get() {
+    	T value;
+    	std::memcpy(&value, Take(sizeof(T)).data(), sizeof(T));
+    	return value;
+    }
+
+    std::string_view GetBytes() {
+    	return Take(Get<uint32_t>());
+    }
+
+    std::string_view Take(size_t size) {
+    	if (size > data_.size()) {
+    		throw std::runtime_error(truncated_message_);
+    	}
+    	const std::string_view result = data_.substr(0, size);
+    	data_.remove_prefix(size);
+    	return result;
+    }
+
+    size_t Remaining() const {
+    	return data_.size();
+    }
+
+private:
+    std::string_view data_;
+    const char* truncated_message_;
+};
@@ -1,57 +1,219 @@
-#include <mutex>
-#include <future>
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
 #include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <type_traits>
 #include <vector>
-#include <cstddef>
 
+// Hash map split into cache-line aligned shards, each one a flat open addressing table
 template<typename Key, typename Value>
 class ConcurrentMap {
-	public:
-		static_assert(std::is_integral<Key>::value, "Integral required.");
+	private:
+		static constexpr size_t CACHE_LINE_SIZE = 64;
+		static constexpr size_t MIN_SHARD_CAPACITY = 16;
 
-		struct Bucket {
-			std::mutex mutex_;
-			std::map<Key, Value> map_;
+		enum class SlotState : uint8_t {
+			EMPTY,
+			FULL,
+			ERASED,
 		};
 
+		struct Slot {
+			Key key{};
+			Value value{};
+			SlotState state = SlotState::EMPTY;
+		};
+
+		struct alignas(CACHE_LINE_SIZE) Shard {
+			std::shared_mutex mutex_;
+			std::vector<Slot> slots_;
+			size_t size_ = 0;
+			size_t used_ = 0;
+
+			Slot* Find(const Key& key, uint64_t hash) {
+				if (slots_.empty()) {
+					return nullptr;
+				}
+				const size_t mask = slots_.size() - 1;
+				for (size_t i = hash & mask; ; i = (i + 1) & mask) {
+					Slot& slot = slots_[i];
+					if (slot.state == SlotState::EMPTY) {
+						return nullptr;
+					}
+					if (slot.state == SlotState::FULL && slot.key == key) {
+						return &slot;
+					}
+				}
+			}
+
+			Value& FindOrInsert(const Key& key, uint64_t hash) {
+				if (Slot* slot = Find(key, hash)) {
+					return slot->value;
+				}
+				if ((used_ + 1) * 4 > slots_.size() * 3) {
+					Rehash(std::max(MIN_SHARD_CAPACITY, (size_ + 1) * 2 > slots_.size() ? slots_.size() * 2 : slots_.size()));
+				}
+				Slot& slot = FindFreeSlot(hash);
+				if (slot.state == SlotState::EMPTY) {
+					++used_;
+				}
+				slot.key = key;
+				slot.value = Value{};
+				slot.state = SlotState::FULL;
+				++size_;
+				return slot.value;
+			}
+
+			Slot& FindFreeSlot(uint64_t hash) {
+				const size_t mask = slots_.size() - 1;
+				size_t i = hash & mask;
+				while (slots_[i].state == SlotState::FULL) {
+					i = (i + 1) & mask;
+				}
+				return slots_[i];
+			}
+
+			void Rehash(size_t capacity) {
+				std::vector<Slot> old_slots(capacity);
+				old_slots.swap(slots_);
+				used_ = size_;
+				for (Slot& slot : old_slots) {
+					if (slot.state == SlotState::FULL) {
+						Slot& new_slot = FindFreeSlot(Hash(slot.key));
+						new_slot.key = slot.key;
+						new_slot.value = std::move(slot.value);
+						new_slot.state = SlotState::FULL;
+					}
+				}
+			}
+		};
+
+	public:
+		static_assert(std::is_integral<Key>::value, "Integral required.");
+
 		struct Access {
-			Access(const Key& key, Bucket& bucket)
-				: lock_guard(bucket.mutex_)
-				, ref_to_value(bucket.map_[key])
+			Access(const Key& key, uint64_t hash, Shard& shard)
+				: lock_guard(shard.mutex_)
+				, ref_to_value(shard.FindOrInsert(key, hash))
 			{
 			}
-			std::lock_guard<std::mutex> lock_guard;
+			std::unique_lock<std::shared_mutex> lock_guard;
 			Value& ref_to_value;
 		};
 
+		ConcurrentMap()
+			: ConcurrentMap(DefaultShardCount())
+		{
+		}
+
 		explicit ConcurrentMap(size_t bucket_count)
-			: buckets_(bucket_count)
+			: shards_(std::max<size_t>(bucket_count, 1))
 		{
 		}
 
 		Access operator[](const Key& key) {
-			return Access{key, buckets_[static_cast<uint64_t>(key) % buckets_.size()]};
+			const uint64_t hash = Hash(key);
+			return Access{key, hash, GetShard(hash)};
 		};
 
-		std::map<Key, Value> BuildOrdinaryMap() {
-			std::map<Key, Value> ordinary_map;
-			for (auto& [mutex_, map_] : buckets_) {
-				{
-					std::lock_guard<std::mutex> lock_(mutex_);
-					ordinary_map.insert(map_.begin(),map_.end());
+		// Adds delta to the value of key; an existing key is updated atomically under a shared lock
+		void Add(const Key& key, const Value& delta) {
+			static_assert(std::is_arithmetic<Value>::value, "Arithmetic value required.");
+			const uint64_t hash = Hash(key);
+			Shard& shard = GetShard(hash);
+			{
+				std::shared_lock<std::shared_mutex> lock(shard.mutex_);
+				if (Slot* slot = shard.Find(key, hash)) {
+					std::atomic_ref<Value>(slot->value).fetch_add(delta, std::memory_order_relaxed);
+					return;
 				}
 			}
-			return ordinary_map;
+			std::unique_lock<std::shared_mutex> lock(shard.mutex_);
+			shard.FindOrInsert(key, hash) += delta;
+		}
+
+		void erase(const Key& key) {
+			const uint64_t hash = Hash(key);
+			Shard& shard = GetShard(hash);
+
+			std::unique_lock<std::shared_mutex> lock(shard.mutex_);
+			if (Slot* slot = shard.Find(key, hash)) {
+				slot->state = SlotState::ERASED;
+				slot->value = Value{};
+				--shard.size_;
+			}
 		}
 
-	    void erase(const Key& key) {
-	    	const size_t i = static_cast<size_t>(key) % buckets_.size();
+		// Visits every entry in place in unspecified order, one shard locked at a time
+		template <typename Function>
+		void ForEach(Function function) {
+			for (Shard& shard : shards_) {
+				std::unique_lock<std::shared_mutex> lock(shard.mutex_);
+				for (Slot& slot : shard.slots_) {
+					if (slot.state == SlotState::FULL) {
+						function(slot.key, slot.value);
+					}
+				}
+			}
+		}
 
-	    	std::lock_guard<std::mutex> lock_guard(buckets_[i].mutex_);
-	    	buckets_[i].map_.erase(key);
-	    }
+		// Moves every entry out to function in unspecified order and leaves the map empty
+		template <typename Function>
+		void Drain(Function function) {
+			for (Shard& shard : shards_) {
+				std::unique_lock<std::shared_mutex> lock(shard.mutex_);
+				for (Slot& slot : shard.slots_) {
+					if (slot.state == SlotState::FULL) {
+						function(slot.key, std::move(slot.value));
+					}
+				}
+				shard.slots_.clear();
+				shard.size_ = 0;
+				shard.used_ = 0;
+			}
+		}
+
+		size_t size() {
+			size_t total = 0;
+			for (Shard& shard : shards_) {
+				std::shared_lock<std::shared_mutex> lock(shard.mutex_);
+				total += shard.size_;
+			}
+			return total;
+		}
+
+		std::map<Key, Value> BuildOrdinaryMap() {
+			std::map<Key, Value> ordinary_map;
+			ForEach([&ordinary_map](const Key& key, const Value& value) {
+				ordinary_map.emplace(key, value);
+			});
+			return ordinary_map;
+		}
 
 	private:
-		std::vector<Bucket> buckets_;
-};
+		std::vector<Shard> shards_;
+
+		static size_t DefaultShardCount() {
+			return std::max(1u, std::thread::hardware_concurrency()) * 4;
+		}
 
+		static uint64_t Hash(const Key& key) {
+			uint64_t x = static_cast<uint64_t>(key);
+			x ^= x >> 33;
+			x *= 0xff51afd7ed558ccdULL;
+			x ^= x >> 33;
+			x *= 0xc4ceb9fe1a85ec53ULL;
+			x ^= x >> 33;
+			return x;
+		}
+
+		Shard& GetShard(uint64_t hash) {
+			return shards_[(hash >> 32) % shards_.size()];
+		}
+};
@@ -0,0 +1,323 @@
+#include "corpus_loader.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const size_t CHUNK_SIZE = 4 << 20;
+const size_t MAX_CHUNKS_IN_FLIGHT = 2;
+
+class FileDescriptor {
+public:
+    explicit FileDescriptor(int fd)
+    	: fd_(fd)
+    {
+    }
+
+    FileDescriptor(const FileDescriptor&) = delete;
+    FileDescriptor& operator=(const FileDescriptor&) = delete;
+
+    ~FileDescriptor() {
+    	if (fd_ >= 0) {
+    		close(fd_);
+    	}
+    }
+
+    int Get() const {
+    	return fd_;
+    }
+
+private:
+    int fd_;
+};
+
+class ChunkQueue {
+public:
+    // Returns false once the consumer has closed the queue
+    bool Push(std::string chunk) {
+    	std::unique_lock lock(mutex_);
+    	not_full_.wait(lock, [this] { return chunks_.size() < MAX_CHUNKS_IN_FLIGHT || closed_; });
+    	if (closed_) {
+    		return false;
+    	}
+    	chunks_.push_back(std::move(chunk));
+    	not_empty_.notify_one();
+    	return true;
+    }
+
+    std::optional<std::string> Pop() {
+    	std::unique_lock lock(mutex_);
+    	not_empty_.wait(lock, [this] { return !chunks_.empty() || finished_ || closed_; });
+    	if (chunks_.empty() || closed_) {
+    		return std::nullopt;
+    	}
+    	std::string chunk = std::move(chunks_.front());
+    	chunks_.pop_front();
+    	not_full_.notify_one();
+    	return chunk;
+    }
+
+    // Called by the producer after the last chunk, optionally with the error that stopped it
+    void Finish(std::exception_ptr error) {
+    	std::lock_guard lock(mutex_);
+    	finished_ = true;
+    	error_ = error;
+    	not_empty_.notify_all();
+    }
+
+    // Called by the consumer to stop the producer early
+    void Close() {
+    	std::lock_guard lock(mutex_);
+    	closed_ = true;
+    	not_full_.notify_all();
+    	not_empty_.notify_all();
+    }
+
+    std::exception_ptr GetError() {
+    	std::lock_guard lock(mutex_);
+    	return error_;
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+    std::deque<std::string> chunks_;
+    bool finished_ = false;
+    bool closed_ = false;
+    std::exception_ptr error_;
+};
+
+std::string_view NextField(std::string_view& line, char separator) {
+    const size_t pos = line.find(separator);
+    const std::string_view field = line.substr(0, pos);
+    line.remove_prefix(pos == line.npos ? line.size() : pos + 1);
+    return field;
+}
+
+bool ParseInt(std::string_view text, int& value) {
+    const auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return ec == std::errc() && ptr == text.data() + text.size();
+}
+
+bool ParseStatus(std::string_view text, DocumentStatus& status) {
+    if (text == "ACTUAL") {
+    	status = DocumentStatus::ACTUAL;
+    } else if (text == "IRRELEVANT") {
+    	status = DocumentStatus::IRRELEVANT;
+    } else if (text == "BANNED") {
+    	status = DocumentStatus::BANNED;
+    } else if (text == "REMOVED") {
+    	status = DocumentStatus::REMOVED;
+    } else {
+    	return false;
+    }
+    return true;
+}
+
+class CorpusParser {
+public:
+    CorpusParser(SearchServer& search_server, CorpusFormat format)
+    	: search_server_(search_server)
+    	, format_(format)
+    {
+    }
+
+    // Expects the buffer to end on a line boundary
+    void ProcessBuffer(std::string_view buffer) {
+    	stats_.bytes_read += buffer.size();
+    	while (!buffer.empty()) {
+    		std::string_view line = NextField(buffer, '\n');
+    		if (!line.empty() && line.back() == '\r') {
+    			line.remove_suffix(1);
+    		}
+    		ProcessLine(line);
+    		++line_number_;
+    	}
+    }
+
+    const CorpusLoadStats& GetStats() const {
+    	return stats_;
+    }
+
+private:
+    SearchServer& search_server_;
+    CorpusFormat format_;
+    CorpusLoadStats stats_;
+    int line_number_ = 0;
+    std::vector<int> ratings_;
+
+    void ProcessLine(std::string_view line) {
+    	if (line.empty()) {
+    		return;
+    	}
+    	int document_id = line_number_;
+    	DocumentStatus status = DocumentStatus::ACTUAL;
+    	ratings_.clear();
+    	if (format_ == CorpusFormat::TSV && !ParseRecord(line, document_id, status)) {
+    		++stats_.lines_rejected;
+    		return;
+    	}
+    	try {
+    		search_server_.AddDocument(document_id, line, status, ratings_);
+    		++stats_.documents_added;
+    	} catch (const std::invalid_argument&) {
+    		++stats_.lines_rejected;
+    	}
+    }
+
+    // Leaves the document text in line
+    bool ParseRecord(std::string_view& line, int& document_id, DocumentStatus& status) {
+    	if (!ParseInt(NextField(line, '\t'), document_id) || !ParseStatus(NextField(line, '\t'), status)) {
+    		return false;
+    	}
+    	std::string_view ratings = NextField(line, '\t');
+    	while (!ratings.empty()) {
+    		const std::string_view rating_text = NextField(ratings, ' ');
+    		if (rating_text.empty()) {
+    			continue;
+    		}
+    		int rating = 0;
+    		if (!ParseInt(rating_text, rating)) {
+    			return false;
+    		}
+    		ratings_.push_back(rating);
+    	}
+    	return true;
+    }
+};
+
+class MappedRegion {
+public:
+    MappedRegion(void* data, size_t size)
+    	: data_(data), size_(size)
+    {
+    }
+
+    MappedRegion(const MappedRegion&) = delete;
+    MappedRegion& operator=(const MappedRegion&) = delete;
+
+    ~MappedRegion() {
+    	munmap(data_, size_);
+    }
+
+    std::string_view GetView() const {
+    	return {static_cast<const char*>(data_), size_};
+    }
+
+private:
+    void* data_;
+    size_t size_;
+};
+
+// Pushes chunks that end on a line boundary, a line longer than a chunk grows the next chunk
+void ReadChunks(int fd, ChunkQueue& queue) {
+    std::string carry;
+    bool eof = false;
+    while (!eof) {
+    	std::string chunk = std::move(carry);
+    	carry = std::string();
+    	size_t filled = chunk.size();
+    	chunk.resize(std::max(CHUNK_SIZE, filled * 2));
+    	while (filled < chunk.size()) {
+    		const ssize_t count = read(fd, chunk.data() + filled, chunk.size() - filled);
+    		if (count < 0) {
+    			if (errno == EINTR) {
+    				continue;
+    			}
+    			throw std::system_error(errno, std::generic_category(), "corpus read failed");
+    		}
+    		if (count == 0) {
+    			eof = true;
+    			break;
+    		}
+    		filled += count;
+    	}
+    	chunk.resize(filled);
+
+    	if (!eof) {
+    		const size_t last_newline = chunk.rfind('\n');
+    		if (last_newline == chunk.npos) {
+    			carry = std::move(chunk);
+    			continue;
+    		}
+    		carry.assign(chunk, last_newline + 1);
+    		chunk.resize(last_newline + 1);
+    	}
+    	if (!chunk.empty() && !queue.Push(std::move(chunk))) {
+    		return;
+    	}
+    }
+}
+
+} // namespace
+
+CorpusLoadStats LoadCorpusFromFile(SearchServer& search_server, const std::string& path, CorpusFormat format) {
+    const FileDescriptor file(open(path.c_str(), O_RDONLY | O_CLOEXEC));
+    if (file.Get() < 0) {
+    	throw std::system_error(errno, std::generic_category(), "cannot open corpus " + path);
+    }
+    struct stat info;
+    if (fstat(file.Get(), &info) != 0 || !S_ISREG(info.st_mode) || info.st_size == 0) {
+    	return LoadCorpusFromDescriptor(search_server, file.Get(), format);
+    }
+    void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, file.Get(), 0);
+    if (data == MAP_FAILED) {
+    	return LoadCorpusFromDescriptor(search_server, file.Get(), format);
+    }
+    const MappedRegion region(data, info.st_size);
+    madvise(data, info.st_size, MADV_SEQUENTIAL);
+
+    CorpusParser parser(search_server, format);
+    parser.ProcessBuffer(region.GetView());
+    return parser.GetStats();
+}
+
+CorpusLoadStats LoadCorpusFromDescriptor(SearchServer& search_server, int fd, CorpusFormat format) {
+    ChunkQueue queue;
+    std::thread producer([fd, &queue] {
+    	try {
+    		ReadChunks(fd, queue);
+    		queue.Finish(nullptr);
+    	} catch (...) {
+    		queue.Finish(std::current_exception());
+    	}
+    });
+
+    CorpusParser parser(search_server, format);
+    try {
+    	while (std::optional<std::string> chunk = queue.Pop()) {
+    		parser.ProcessBuffer(*chunk);
+    	}
+    } catch (...) {
+    	queue.Close();
+    	producer.join();
+    	throw;
+    }
+    producer.join();
+    if (const std::exception_ptr error = queue.GetError()) {
+    	std::rethrow_exception(error);
+    }
+    return parser.GetStats();
+}
+
+CorpusLoadStats LoadCorpusFromStdin(SearchServer& search_server, CorpusFormat format) {
+    return LoadCorpusFromDescriptor(search_server, STDIN_FILENO, format);
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "search_server.h"
+
+#include <cstddef>
+#include <string>
+
+// LINES: one document per line, id is the line number starting from 0, status ACTUAL, no ratings
+// TSV: id<TAB>status<TAB>space separated ratings<TAB>text, status is ACTUAL, IRRELEVANT, BANNED or REMOVED
+enum class CorpusFormat {
+    LINES,
+    TSV,
+};
+
+struct CorpusLoadStats {
+    size_t documents_added = 0;
+    size_t lines_rejected = 0;
+    size_t bytes_read = 0;
+};
+
+// Maps the file into memory when possible and falls back to streaming reads
+CorpusLoadStats LoadCorpusFromFile(SearchServer& search_server, const std::string& path, CorpusFormat format);
+
+// Reads the descriptor in large chunks on a producer thread while documents are added on the calling thread
+CorpusLoadStats LoadCorpusFromDescriptor(SearchServer& search_server, int fd, CorpusFormat format);
+
+CorpusLoadStats LoadCorpusFromStdin(SearchServer& search_server, CorpusFormat format);
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory_resource>
+
+struct MemoryStats {
+    size_t bytes_in_use = 0;
+    size_t peak_bytes_in_use = 0;
+    size_t allocation_count = 0;
+    size_t deallocation_count = 0;
+};
+
+// Forwards to an upstream resource and keeps thread-safe allocation statistics
+class CountingMemoryResource : public std::pmr::memory_resource {
+public:
+    explicit CountingMemoryResource(std::pmr::memory_resource* upstream = std::pmr::get_default_resource());
+
+    MemoryStats GetStats() const;
+    std::pmr::memory_resource* GetUpstream() const;
+
+private:
+    std::pmr::memory_resource* upstream_;
+    std::atomic<size_t> bytes_in_use_ = 0;
+    std::atomic<size_t> peak_bytes_in_use_ = 0;
+    std::atomic<size_t> allocation_count_ = 0;
+    std::atomic<size_t> deallocation_count_ = 0;
+
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+};
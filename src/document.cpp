@@ -1,5 +1,7 @@
 #include "document.h"
 
+#include <cmath>
+
 Document::Document() = default;
 
 Document::Document(int id, double relevance, int rating)
@@ -18,3 +20,92 @@ std::ostream& operator<<(std::ostream& os, const Document& document){
 	return os;
 }
 
+bool IsRankedBefore(const Document& lhs, const Document& rhs) {
+    if (std::abs(lhs.relevance - rhs.relevance) >= 1e-6) {
+        return lhs.relevance > rhs.relevance;
+    }
+    if (lhs.rating != rhs.rating) {
+        return lhs.rating > rhs.rating;
+    }
+    return lhs.id < rhs.id;
+}
+
+bool IsRankedBeforeExact(const Document& lhs, const Document& rhs) {
+    if (lhs.relevance != rhs.relevance) {
+        return lhs.relevance > rhs.relevance;
+    }
+    if (lhs.rating != rhs.rating) {
+        return lhs.rating > rhs.rating;
+    }
+    return lhs.id < rhs.id;
+}
+
+size_t MatchedDocuments::size() const {
+	return document_ids.size();
+}
+
+std::span<const std::string_view> MatchedDocuments::GetWords(size_t index) const {
+	return {words.data() + offsets[index], offsets[index + 1] - offsets[index]};
+}
+
+DocumentTerms::Iterator::Iterator(const std::string_view* word, const double* term_freq)
+	: word_(word)
+	, term_freq_(term_freq)
+{
+}
+
+DocumentTerms::Iterator::value_type DocumentTerms::Iterator::operator*() const {
+	return {*word_, *term_freq_};
+}
+
+DocumentTerms::Iterator& DocumentTerms::Iterator::operator++() {
+	++word_;
+	++term_freq_;
+	return *this;
+}
+
+DocumentTerms::Iterator DocumentTerms::Iterator::operator++(int) {
+	Iterator previous = *this;
+	++*this;
+	return previous;
+}
+
+bool DocumentTerms::Iterator::operator==(const Iterator& other) const {
+	return word_ == other.word_;
+}
+
+DocumentTerms::DocumentTerms(std::span<const int> term_ids, std::span<const std::string_view> words,
+		std::span<const double> term_freqs)
+	: term_ids_(term_ids)
+	, words_(words)
+	, term_freqs_(term_freqs)
+{
+}
+
+size_t DocumentTerms::size() const {
+	return term_ids_.size();
+}
+
+bool DocumentTerms::empty() const {
+	return term_ids_.empty();
+}
+
+DocumentTerms::Iterator DocumentTerms::begin() const {
+	return {words_.data(), term_freqs_.data()};
+}
+
+DocumentTerms::Iterator DocumentTerms::end() const {
+	return {words_.data() + words_.size(), term_freqs_.data() + term_freqs_.size()};
+}
+
+std::span<const int> DocumentTerms::GetTermIds() const {
+	return term_ids_;
+}
+
+std::span<const std::string_view> DocumentTerms::GetWords() const {
+	return words_;
+}
+
+std::span<const double> DocumentTerms::GetTermFreqs() const {
+	return term_freqs_;
+}
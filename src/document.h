@@ -1,6 +1,12 @@
 #pragma once
 
+#include <cstddef>
 #include <iostream>
+#include <iterator>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 enum class DocumentStatus {
     ACTUAL,
@@ -20,3 +26,64 @@ struct Document {
 
 std::ostream& operator<<(std::ostream& os, const Document& document);
 
+// Ranking order of search results: relevance descending with 1e-6 tolerance, then rating descending, then id
+bool IsRankedBefore(const Document& lhs, const Document& rhs);
+// Strict total order for cursors: exact relevance descending, then rating descending, then id
+bool IsRankedBeforeExact(const Document& lhs, const Document& rhs);
+
+
+// Results of a batch MatchDocument: matched words of all documents share one flat array
+struct MatchedDocuments {
+    std::vector<int> document_ids;
+    std::vector<DocumentStatus> statuses;
+    std::vector<size_t> offsets;
+    std::vector<std::string_view> words;
+
+    size_t size() const;
+    std::span<const std::string_view> GetWords(size_t index) const;
+};
+
+// Forward index entry of one document: terms sorted by term id with aligned words and frequencies.
+// The spans point into the index and stay valid until the document is removed
+class DocumentTerms {
+public:
+    class Iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using iterator_concept = std::forward_iterator_tag;
+        using value_type = std::pair<std::string_view, double>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = value_type;
+
+        Iterator() = default;
+        Iterator(const std::string_view* word, const double* term_freq);
+
+        value_type operator*() const;
+        Iterator& operator++();
+        Iterator operator++(int);
+        bool operator==(const Iterator& other) const;
+
+    private:
+        const std::string_view* word_ = nullptr;
+        const double* term_freq_ = nullptr;
+    };
+
+    DocumentTerms() = default;
+    DocumentTerms(std::span<const int> term_ids, std::span<const std::string_view> words,
+    		std::span<const double> term_freqs);
+
+    size_t size() const;
+    bool empty() const;
+    // Iterates (word, term frequency) pairs in term id order
+    Iterator begin() const;
+    Iterator end() const;
+    std::span<const int> GetTermIds() const;
+    std::span<const std::string_view> GetWords() const;
+    std::span<const double> GetTermFreqs() const;
+
+private:
+    std::span<const int> term_ids_;
+    std::span<const std::string_view> words_;
+    std::span<const double> term_freqs_;
+};
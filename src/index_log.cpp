@@ -0,0 +1,472 @@
+#include "index_log.h"
+
+#include "binary_codec.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <execution>
+#include <filesystem>
+#include <map>
+#include <stdexcept>
+#include <system_error>
+#include <tuple>
+
+#include <fcntl.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const uint8_t RECORD_ADD = 1;
+const uint8_t RECORD_REMOVE = 2;
+const char CHECKPOINT_MAGIC[4] = {'S', 'S', 'C', 'K'};
+const uint32_t CHECKPOINT_VERSION = 1;
+const size_t LOG_HEADER_SIZE = sizeof(uint32_t) * 2 + sizeof(uint64_t) + sizeof(uint8_t);
+const size_t FRAME_HEADER_SIZE = sizeof(uint32_t) * 2;
+const char* const RECORD_TRUNCATED = "index log record is truncated";
+
+std::system_error MakeSystemError(const std::string& what) {
+    return std::system_error(errno, std::generic_category(), what);
+}
+
+uint32_t Checksum(std::string_view data, uint32_t hash = 2166136261u) {
+    for (const char c : data) {
+    	hash ^= static_cast<uint8_t>(c);
+    	hash *= 16777619u;
+    }
+    return hash;
+}
+
+void WriteAll(int fd, std::string_view data) {
+    while (!data.empty()) {
+    	const ssize_t count = write(fd, data.data(), data.size());
+    	if (count < 0) {
+    		if (errno == EINTR) {
+    			continue;
+    		}
+    		throw MakeSystemError("index log write failed");
+    	}
+    	data.remove_prefix(count);
+    }
+}
+
+std::string ReadAll(int fd) {
+    std::string data;
+    char buffer[1 << 16];
+    off_t offset = 0;
+    while (true) {
+    	const ssize_t count = pread(fd, buffer, sizeof(buffer), offset);
+    	if (count < 0) {
+    		if (errno == EINTR) {
+    			continue;
+    		}
+    		throw MakeSystemError("index log read failed");
+    	}
+    	if (count == 0) {
+    		return data;
+    	}
+    	data.append(buffer, count);
+    	offset += count;
+    }
+}
+
+void SyncDirectory(const std::string& directory) {
+    const int fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+    	throw MakeSystemError("cannot open " + directory);
+    }
+    const int result = fsync(fd);
+    close(fd);
+    if (result != 0) {
+    	throw MakeSystemError("cannot sync " + directory);
+    }
+}
+
+std::string ParentDirectory(const std::string& directory) {
+    const std::string parent = std::filesystem::path(directory).lexically_normal().parent_path().string();
+    return parent.empty() ? "." : parent;
+}
+
+struct LogRecord {
+    uint64_t lsn = 0;
+    uint8_t type = 0;
+    int document_id = 0;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+    std::string_view text;
+};
+
+struct DocumentSnapshot {
+    int document_id = 0;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    int rating = 0;
+    std::map<std::string_view, double> word_freqs;
+};
+
+LogRecord DecodeLogRecord(uint64_t lsn, uint8_t type, std::string_view payload) {
+    LogRecord record;
+    record.lsn = lsn;
+    record.type = type;
+    BinaryReader reader(payload, RECORD_TRUNCATED);
+    record.document_id = reader.Get<int32_t>();
+    if (type == RECORD_ADD) {
+    	record.status = static_cast<DocumentStatus>(reader.Get<int32_t>());
+    	record.ratings.resize(reader.Get<uint32_t>());
+    	for (int& rating : record.ratings) {
+    		rating = reader.Get<int32_t>();
+    	}
+    	record.text = reader.GetBytes();
+    }
+    return record;
+}
+
+DocumentSnapshot DecodeDocumentSnapshot(std::string_view payload) {
+    DocumentSnapshot snapshot;
+    BinaryReader reader(payload, RECORD_TRUNCATED);
+    snapshot.document_id = reader.Get<int32_t>();
+    snapshot.status = static_cast<DocumentStatus>(reader.Get<int32_t>());
+    snapshot.rating = reader.Get<int32_t>();
+    for (uint32_t i = reader.Get<uint32_t>(); i > 0; --i) {
+    	const std::string_view word = reader.GetBytes();
+    	snapshot.word_freqs.emplace(word, reader.Get<double>());
+    }
+    return snapshot;
+}
+
+} // namespace
+
+IndexLog::IndexLog(const std::string& directory)
+	: directory_(directory)
+	, log_path_(directory + "/index.log")
+	, checkpoint_path_(directory + "/index.checkpoint")
+{
+    if (mkdir(directory_.c_str(), 0755) == 0) {
+    	SyncDirectory(ParentDirectory(directory_));
+    } else if (errno != EEXIST) {
+    	throw MakeSystemError("cannot create " + directory_);
+    }
+    log_fd_ = open(log_path_.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (log_fd_ < 0) {
+    	throw MakeSystemError("cannot open " + log_path_);
+    }
+    // a freshly created log has to survive a crash as a directory entry, not only as synced data
+    try {
+    	SyncDirectory(directory_);
+    	durable_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    	if (durable_fd_ < 0) {
+    		throw MakeSystemError("eventfd");
+    	}
+    } catch (...) {
+    	close(log_fd_);
+    	throw;
+    }
+    flusher_ = std::thread([this] { FlushLoop(); });
+}
+
+IndexLog::~IndexLog() {
+    {
+    	std::lock_guard lock(mutex_);
+    	stopping_ = true;
+    }
+    pending_cv_.notify_all();
+    flusher_.join();
+    close(durable_fd_);
+    close(log_fd_);
+}
+
+RecoveryStats IndexLog::Recover(SearchServer& search_server) {
+    if (search_server.GetDocumentCount() != 0) {
+    	throw std::logic_error("recovery requires an empty search server");
+    }
+    RecoveryStats stats;
+    const uint64_t checkpoint_lsn = LoadCheckpoint(search_server, stats);
+
+    std::lock_guard file_lock(file_mutex_);
+    const std::string log = ReadAll(log_fd_);
+    std::vector<std::tuple<uint64_t, uint8_t, std::string_view>> frames;
+    BinaryReader reader(log, RECORD_TRUNCATED);
+    size_t valid_size = 0;
+    while (reader.Remaining() >= LOG_HEADER_SIZE) {
+    	const uint32_t size = reader.Get<uint32_t>();
+    	const uint32_t checksum = reader.Get<uint32_t>();
+    	const std::string_view checked = std::string_view(log).substr(valid_size + FRAME_HEADER_SIZE, sizeof(uint64_t) + sizeof(uint8_t));
+    	const uint64_t lsn = reader.Get<uint64_t>();
+    	const uint8_t type = reader.Get<uint8_t>();
+    	if (size > reader.Remaining()) {
+    		break;
+    	}
+    	const std::string_view payload = reader.Take(size);
+    	if (Checksum(payload, Checksum(checked)) != checksum || (type != RECORD_ADD && type != RECORD_REMOVE)) {
+    		break;
+    	}
+    	frames.emplace_back(lsn, type, payload);
+    	valid_size += LOG_HEADER_SIZE + size;
+    }
+    if (valid_size < log.size()) {
+    	if (ftruncate(log_fd_, valid_size) != 0 || fsync(log_fd_) != 0) {
+    		throw MakeSystemError("cannot truncate " + log_path_);
+    	}
+    	stats.log_tail_truncated = true;
+    }
+
+    std::vector<LogRecord> records(frames.size());
+    std::atomic<bool> malformed = false;
+    std::transform(std::execution::par, frames.begin(), frames.end(), records.begin(), [&malformed](const auto& frame) {
+    	try {
+    		return DecodeLogRecord(std::get<0>(frame), std::get<1>(frame), std::get<2>(frame));
+    	} catch (const std::runtime_error&) {
+    		malformed = true;
+    		return LogRecord{};
+    	}
+    });
+    if (malformed) {
+    	throw std::runtime_error("index log has a malformed record: " + log_path_);
+    }
+
+    uint64_t last_lsn = checkpoint_lsn;
+    for (const LogRecord& record : records) {
+    	last_lsn = std::max(last_lsn, record.lsn);
+    	if (record.lsn <= checkpoint_lsn) {
+    		++stats.log_records_skipped;
+    		continue;
+    	}
+    	try {
+    		if (record.type == RECORD_ADD) {
+    			search_server.AddDocument(record.document_id, record.text, record.status, record.ratings);
+    		} else {
+    			search_server.RemoveDocument(record.document_id);
+    		}
+    		++stats.log_records_applied;
+    	} catch (const std::invalid_argument&) {
+    		++stats.log_records_skipped;
+    	}
+    }
+
+    std::lock_guard lock(mutex_);
+    next_lsn_ = last_lsn + 1;
+    durable_lsn_ = last_lsn;
+    return stats;
+}
+
+void IndexLog::AddDocument(SearchServer& search_server, int document_id, const std::string_view& document,
+		DocumentStatus status, const std::vector<int>& ratings) {
+    search_server.AddDocument(document_id, document, status, ratings);
+    WaitDurable(AppendAdd(document_id, document, status, ratings));
+}
+
+void IndexLog::RemoveDocument(SearchServer& search_server, int document_id) {
+    search_server.RemoveDocument(document_id);
+    WaitDurable(AppendRemove(document_id));
+}
+
+uint64_t IndexLog::AppendAdd(int document_id, const std::string_view& document, DocumentStatus status,
+		const std::vector<int>& ratings) {
+    std::string payload;
+    payload.reserve(sizeof(int32_t) * (4 + ratings.size()) + document.size());
+    Put(payload, static_cast<int32_t>(document_id));
+    Put(payload, static_cast<int32_t>(status));
+    Put(payload, static_cast<uint32_t>(ratings.size()));
+    for (const int rating : ratings) {
+    	Put(payload, static_cast<int32_t>(rating));
+    }
+    PutBytes(payload, document);
+    return Append(RECORD_ADD, payload);
+}
+
+uint64_t IndexLog::AppendRemove(int document_id) {
+    std::string payload;
+    Put(payload, static_cast<int32_t>(document_id));
+    return Append(RECORD_REMOVE, payload);
+}
+
+void IndexLog::WaitDurable(uint64_t lsn) {
+    std::unique_lock lock(mutex_);
+    durable_cv_.wait(lock, [this, lsn] { return durable_lsn_ >= lsn || error_; });
+    if (error_) {
+    	std::rethrow_exception(error_);
+    }
+}
+
+int IndexLog::GetDurableEventFd() const {
+    return durable_fd_;
+}
+
+uint64_t IndexLog::PollDurable() {
+    uint64_t value;
+    [[maybe_unused]] const ssize_t bytes_read = read(durable_fd_, &value, sizeof(value));
+    std::lock_guard lock(mutex_);
+    if (error_) {
+    	std::rethrow_exception(error_);
+    }
+    return durable_lsn_;
+}
+
+void IndexLog::Checkpoint(const SearchServer& search_server) {
+    uint64_t lsn = 0;
+    {
+    	std::lock_guard lock(mutex_);
+    	lsn = next_lsn_ - 1;
+    }
+    WaitDurable(lsn);
+
+    std::string data(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+    Put(data, CHECKPOINT_VERSION);
+    Put(data, lsn);
+    Put(data, static_cast<uint64_t>(search_server.GetDocumentCount()));
+    std::string payload;
+    for (const int document_id : search_server) {
+    	payload.clear();
+    	const auto& word_freqs = search_server.GetWordFrequencies(document_id);
+    	Put(payload, static_cast<int32_t>(document_id));
+    	Put(payload, static_cast<int32_t>(search_server.GetDocumentStatus(document_id)));
+    	Put(payload, static_cast<int32_t>(search_server.GetDocumentRating(document_id)));
+    	Put(payload, static_cast<uint32_t>(word_freqs.size()));
+    	for (const auto& [word, term_freq] : word_freqs) {
+    		PutBytes(payload, word);
+    		Put(payload, term_freq);
+    	}
+    	Put(data, static_cast<uint32_t>(payload.size()));
+    	Put(data, Checksum(payload));
+    	data += payload;
+    }
+
+    const std::string temp_path = checkpoint_path_ + ".tmp";
+    const int fd = open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+    	throw MakeSystemError("cannot create " + temp_path);
+    }
+    try {
+    	WriteAll(fd, data);
+    	if (fsync(fd) != 0) {
+    		throw MakeSystemError("cannot sync " + temp_path);
+    	}
+    } catch (...) {
+    	close(fd);
+    	throw;
+    }
+    close(fd);
+    if (rename(temp_path.c_str(), checkpoint_path_.c_str()) != 0) {
+    	throw MakeSystemError("cannot replace " + checkpoint_path_);
+    }
+    SyncDirectory(directory_);
+
+    std::lock_guard file_lock(file_mutex_);
+    if (ftruncate(log_fd_, 0) != 0 || fsync(log_fd_) != 0) {
+    	throw MakeSystemError("cannot truncate " + log_path_);
+    }
+}
+
+uint64_t IndexLog::Append(uint8_t type, const std::string& payload) {
+    std::lock_guard lock(mutex_);
+    if (error_) {
+    	std::rethrow_exception(error_);
+    }
+    const uint64_t lsn = next_lsn_++;
+    std::string checked;
+    Put(checked, lsn);
+    Put(checked, type);
+    Put(pending_, static_cast<uint32_t>(payload.size()));
+    Put(pending_, Checksum(payload, Checksum(checked)));
+    pending_ += checked;
+    pending_ += payload;
+    pending_cv_.notify_one();
+    return lsn;
+}
+
+// Everything appended while the previous batch was being synced goes out in the next write and fdatasync
+void IndexLog::FlushLoop() {
+    std::unique_lock lock(mutex_);
+    while (true) {
+    	pending_cv_.wait(lock, [this] { return !pending_.empty() || stopping_; });
+    	if (pending_.empty()) {
+    		return;
+    	}
+    	std::string batch;
+    	batch.swap(pending_);
+    	const uint64_t batch_lsn = next_lsn_ - 1;
+    	lock.unlock();
+    	try {
+    		std::lock_guard file_lock(file_mutex_);
+    		WriteAll(log_fd_, batch);
+    		if (fdatasync(log_fd_) != 0) {
+    			throw MakeSystemError("cannot sync " + log_path_);
+    		}
+    	} catch (...) {
+    		lock.lock();
+    		error_ = std::current_exception();
+    		durable_cv_.notify_all();
+    		NotifyDurable();
+    		return;
+    	}
+    	lock.lock();
+    	durable_lsn_ = batch_lsn;
+    	durable_cv_.notify_all();
+    	NotifyDurable();
+    }
+}
+
+// Called with mutex_ held after durable_lsn_ or error_ changed, so PollDurable after the event sees the change
+void IndexLog::NotifyDurable() {
+    const uint64_t value = 1;
+    [[maybe_unused]] const ssize_t written = write(durable_fd_, &value, sizeof(value));
+}
+
+uint64_t IndexLog::LoadCheckpoint(SearchServer& search_server, RecoveryStats& stats) {
+    const int fd = open(checkpoint_path_.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+    	if (errno == ENOENT) {
+    		return 0;
+    	}
+    	throw MakeSystemError("cannot open " + checkpoint_path_);
+    }
+    std::string data;
+    try {
+    	data = ReadAll(fd);
+    } catch (...) {
+    	close(fd);
+    	throw;
+    }
+    close(fd);
+
+    BinaryReader reader(data, RECORD_TRUNCATED);
+    if (reader.Take(sizeof(CHECKPOINT_MAGIC)) != std::string_view(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC))
+    		|| reader.Get<uint32_t>() != CHECKPOINT_VERSION) {
+    	throw std::runtime_error("unsupported checkpoint format in " + checkpoint_path_);
+    }
+    const uint64_t lsn = reader.Get<uint64_t>();
+    std::vector<std::string_view> payloads(reader.Get<uint64_t>());
+    for (std::string_view& payload : payloads) {
+    	const uint32_t size = reader.Get<uint32_t>();
+    	const uint32_t checksum = reader.Get<uint32_t>();
+    	payload = reader.Take(size);
+    	if (Checksum(payload) != checksum) {
+    		throw std::runtime_error("checkpoint is corrupted: " + checkpoint_path_);
+    	}
+    }
+
+    std::vector<DocumentSnapshot> snapshots(payloads.size());
+    std::atomic<bool> malformed = false;
+    std::transform(std::execution::par, payloads.begin(), payloads.end(), snapshots.begin(), [&malformed](std::string_view payload) {
+    	try {
+    		return DecodeDocumentSnapshot(payload);
+    	} catch (const std::runtime_error&) {
+    		malformed = true;
+    		return DocumentSnapshot{};
+    	}
+    });
+    if (malformed) {
+    	throw std::runtime_error("checkpoint is corrupted: " + checkpoint_path_);
+    }
+    for (const DocumentSnapshot& snapshot : snapshots) {
+    	try {
+    		search_server.RestoreDocument(snapshot.document_id, snapshot.status, snapshot.rating, snapshot.word_freqs);
+    	} catch (const std::invalid_argument& e) {
+    		throw std::runtime_error("checkpoint is corrupted: " + checkpoint_path_ + ": " + e.what());
+    	}
+    }
+    stats.checkpoint_documents = snapshots.size();
+    return lsn;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "search_server.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+struct RecoveryStats {
+    size_t checkpoint_documents = 0;
+    size_t log_records_applied = 0;
+    size_t log_records_skipped = 0;
+    bool log_tail_truncated = false;
+};
+
+// Write-ahead log of index mutations with group commit and checkpoints, kept in one directory.
+// Records are written in host byte order, so the files are not portable between architectures.
+class IndexLog {
+public:
+    explicit IndexLog(const std::string& directory);
+
+    IndexLog(const IndexLog&) = delete;
+    IndexLog& operator=(const IndexLog&) = delete;
+
+    ~IndexLog();
+
+    // Loads the last checkpoint and replays the log tail into an empty server; call before logging anything
+    RecoveryStats Recover(SearchServer& search_server);
+
+    // Applies the mutation and returns once its log record is on disk
+    void AddDocument(SearchServer& search_server, int document_id, const std::string_view& document,
+    		DocumentStatus status, const std::vector<int>& ratings);
+    void RemoveDocument(SearchServer& search_server, int document_id);
+
+    // Queue a record without waiting; pass the returned sequence number to WaitDurable
+    uint64_t AppendAdd(int document_id, const std::string_view& document, DocumentStatus status,
+    		const std::vector<int>& ratings);
+    uint64_t AppendRemove(int document_id);
+    void WaitDurable(uint64_t lsn);
+    // Readable whenever more records become durable or the log fails, for callers that cannot block
+    int GetDurableEventFd() const;
+    // Drains the event fd and returns the last durable sequence number; throws the log error once it failed
+    uint64_t PollDurable();
+
+    // Writes a snapshot of the server and truncates the log; no mutations may run concurrently
+    void Checkpoint(const SearchServer& search_server);
+
+private:
+    std::string directory_;
+    std::string log_path_;
+    std::string checkpoint_path_;
+    int log_fd_ = -1;
+    int durable_fd_ = -1;
+
+    std::mutex mutex_;
+    std::condition_variable pending_cv_;
+    std::condition_variable durable_cv_;
+    std::string pending_;
+    uint64_t next_lsn_ = 1;
+    uint64_t durable_lsn_ = 0;
+    bool stopping_ = false;
+    std::exception_ptr error_;
+
+    std::mutex file_mutex_;
+    std::thread flusher_;
+
+    uint64_t Append(uint8_t type, const std::string& payload);
+    void FlushLoop();
+    void NotifyDurable();
+    uint64_t LoadCheckpoint(SearchServer& search_server, RecoveryStats& stats);
+};
@@ -0,0 +1,178 @@
+#include "index_segment.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+std::shared_ptr<IndexSegment> IndexSegment::Build(std::vector<SegmentDocument> documents,
+		std::pmr::memory_resource* resource) {
+    std::sort(documents.begin(), documents.end(), [](const SegmentDocument& lhs, const SegmentDocument& rhs) {
+    	return lhs.id < rhs.id;
+    });
+    if (std::adjacent_find(documents.begin(), documents.end(), [](const SegmentDocument& lhs, const SegmentDocument& rhs) {
+    	return lhs.id == rhs.id;
+    }) != documents.end()) {
+    	throw std::invalid_argument("segment documents must have unique ids");
+    }
+
+    auto segment = std::make_shared<IndexSegment>(resource);
+    size_t posting_count = 0;
+    for (const SegmentDocument& document : documents) {
+    	posting_count += document.term_ids.size();
+    }
+    segment->document_ids_.reserve(documents.size());
+    segment->ratings_.reserve(documents.size());
+    segment->statuses_.reserve(documents.size());
+    segment->deleted_.assign(documents.size(), 0);
+    segment->live_count_ = documents.size();
+    segment->document_term_offsets_.reserve(documents.size() + 1);
+    segment->document_term_ids_.reserve(posting_count);
+    segment->document_term_freqs_.reserve(posting_count);
+    segment->document_term_offsets_.push_back(0);
+    for (const SegmentDocument& document : documents) {
+    	segment->document_ids_.push_back(document.id);
+    	segment->ratings_.push_back(document.rating);
+    	segment->statuses_.push_back(document.status);
+    	segment->document_term_ids_.insert(segment->document_term_ids_.end(), document.term_ids.begin(), document.term_ids.end());
+    	segment->document_term_freqs_.insert(segment->document_term_freqs_.end(), document.term_freqs.begin(), document.term_freqs.end());
+    	segment->document_term_offsets_.push_back(static_cast<uint32_t>(segment->document_term_ids_.size()));
+    }
+
+    // postings are laid out by a counting sort over term ids, then each list is put in impact order
+    segment->term_ids_.assign(segment->document_term_ids_.begin(), segment->document_term_ids_.end());
+    std::sort(segment->term_ids_.begin(), segment->term_ids_.end());
+    segment->term_ids_.erase(std::unique(segment->term_ids_.begin(), segment->term_ids_.end()), segment->term_ids_.end());
+    segment->term_offsets_.assign(segment->term_ids_.size() + 1, 0);
+    std::vector<uint32_t> term_indexes(posting_count);
+    for (size_t i = 0; i < posting_count; ++i) {
+    	const auto it = std::lower_bound(segment->term_ids_.begin(), segment->term_ids_.end(), segment->document_term_ids_[i]);
+    	term_indexes[i] = static_cast<uint32_t>(it - segment->term_ids_.begin());
+    	++segment->term_offsets_[term_indexes[i] + 1];
+    }
+    segment->term_live_counts_.assign(segment->term_offsets_.begin() + 1, segment->term_offsets_.end());
+    for (size_t i = 1; i < segment->term_offsets_.size(); ++i) {
+    	segment->term_offsets_[i] += segment->term_offsets_[i - 1];
+    }
+    segment->posting_documents_.resize(posting_count);
+    segment->posting_term_freqs_.resize(posting_count);
+    std::vector<uint32_t> positions(segment->term_offsets_.begin(), segment->term_offsets_.end() - 1);
+    for (uint32_t index = 0; index < documents.size(); ++index) {
+    	for (uint32_t i = segment->document_term_offsets_[index]; i < segment->document_term_offsets_[index + 1]; ++i) {
+    		const uint32_t position = positions[term_indexes[i]]++;
+    		segment->posting_documents_[position] = index;
+    		segment->posting_term_freqs_[position] = segment->document_term_freqs_[i];
+    	}
+    }
+    std::vector<std::pair<double, uint32_t>> postings;
+    for (size_t term = 0; term < segment->term_ids_.size(); ++term) {
+    	const uint32_t begin = segment->term_offsets_[term];
+    	const uint32_t end = segment->term_offsets_[term + 1];
+    	postings.clear();
+    	for (uint32_t i = begin; i < end; ++i) {
+    		postings.push_back({segment->posting_term_freqs_[i], segment->posting_documents_[i]});
+    	}
+    	std::stable_sort(postings.begin(), postings.end(), [](const auto& lhs, const auto& rhs) {
+    		return lhs.first > rhs.first;
+    	});
+    	for (uint32_t i = begin; i < end; ++i) {
+    		segment->posting_term_freqs_[i] = postings[i - begin].first;
+    		segment->posting_documents_[i] = postings[i - begin].second;
+    	}
+    }
+    return segment;
+}
+
+IndexSegment::IndexSegment(std::pmr::memory_resource* resource)
+	: document_ids_(resource)
+	, ratings_(resource)
+	, statuses_(resource)
+	, deleted_(resource)
+	, document_term_offsets_(resource)
+	, document_term_ids_(resource)
+	, document_term_freqs_(resource)
+	, term_ids_(resource)
+	, term_offsets_(resource)
+	, term_live_counts_(resource)
+	, posting_documents_(resource)
+	, posting_term_freqs_(resource)
+{
+}
+
+size_t IndexSegment::GetDocumentCount() const {
+    return document_ids_.size();
+}
+
+size_t IndexSegment::GetLiveDocumentCount() const {
+    return live_count_;
+}
+
+std::optional<uint32_t> IndexSegment::FindDocument(int document_id) const {
+    const auto it = std::lower_bound(document_ids_.begin(), document_ids_.end(), document_id);
+    if (it == document_ids_.end() || *it != document_id) {
+    	return std::nullopt;
+    }
+    const uint32_t index = static_cast<uint32_t>(it - document_ids_.begin());
+    if (deleted_[index]) {
+    	return std::nullopt;
+    }
+    return index;
+}
+
+bool IndexSegment::IsDeleted(uint32_t index) const {
+    return deleted_[index] != 0;
+}
+
+void IndexSegment::MarkDeleted(uint32_t index) {
+    if (!deleted_[index]) {
+    	deleted_[index] = 1;
+    	--live_count_;
+    	for (const int term_id : GetTermIds(index)) {
+    		--term_live_counts_[std::lower_bound(term_ids_.begin(), term_ids_.end(), term_id) - term_ids_.begin()];
+    	}
+    }
+}
+
+int IndexSegment::GetDocumentId(uint32_t index) const {
+    return document_ids_[index];
+}
+
+int IndexSegment::GetRating(uint32_t index) const {
+    return ratings_[index];
+}
+
+DocumentStatus IndexSegment::GetStatus(uint32_t index) const {
+    return statuses_[index];
+}
+
+std::span<const int> IndexSegment::GetTermIds(uint32_t index) const {
+    return {document_term_ids_.data() + document_term_offsets_[index],
+    		document_term_offsets_[index + 1] - document_term_offsets_[index]};
+}
+
+std::span<const double> IndexSegment::GetTermFreqs(uint32_t index) const {
+    return {document_term_freqs_.data() + document_term_offsets_[index],
+    		document_term_offsets_[index + 1] - document_term_offsets_[index]};
+}
+
+SegmentDocument IndexSegment::GetDocument(uint32_t index) const {
+    return {document_ids_[index], ratings_[index], statuses_[index], GetTermIds(index), GetTermFreqs(index)};
+}
+
+IndexSegment::Postings IndexSegment::GetPostings(int term_id) const {
+    const auto it = std::lower_bound(term_ids_.begin(), term_ids_.end(), term_id);
+    if (it == term_ids_.end() || *it != term_id) {
+    	return {};
+    }
+    const size_t term = it - term_ids_.begin();
+    const size_t begin = term_offsets_[term];
+    const size_t size = term_offsets_[term + 1] - begin;
+    return {{posting_documents_.data() + begin, size}, {posting_term_freqs_.data() + begin, size}};
+}
+
+size_t IndexSegment::GetLiveDocumentFrequency(int term_id) const {
+    const auto it = std::lower_bound(term_ids_.begin(), term_ids_.end(), term_id);
+    if (it == term_ids_.end() || *it != term_id) {
+    	return 0;
+    }
+    return term_live_counts_[it - term_ids_.begin()];
+}
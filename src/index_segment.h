@@ -0,0 +1,73 @@
+#pragma once
+
+#include "document.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <span>
+#include <vector>
+
+// Document handed to IndexSegment::Build, terms sorted by term id
+struct SegmentDocument {
+    int id;
+    int rating;
+    DocumentStatus status;
+    std::span<const int> term_ids;
+    std::span<const double> term_freqs;
+};
+
+// Read-optimized index over a fixed set of documents: postings of every term and terms of every document
+// in flat arrays, documents addressed by a local index in id order. Removal only marks a document deleted
+class IndexSegment {
+public:
+    struct Postings {
+        std::span<const uint32_t> documents;
+        std::span<const double> term_freqs;
+    };
+
+    // Document ids must be unique
+    static std::shared_ptr<IndexSegment> Build(std::vector<SegmentDocument> documents, std::pmr::memory_resource* resource);
+
+    explicit IndexSegment(std::pmr::memory_resource* resource);
+
+    // Including deleted documents
+    size_t GetDocumentCount() const;
+    size_t GetLiveDocumentCount() const;
+    // Local index of a document which is not deleted
+    std::optional<uint32_t> FindDocument(int document_id) const;
+    bool IsDeleted(uint32_t index) const;
+    void MarkDeleted(uint32_t index);
+
+    int GetDocumentId(uint32_t index) const;
+    int GetRating(uint32_t index) const;
+    DocumentStatus GetStatus(uint32_t index) const;
+    std::span<const int> GetTermIds(uint32_t index) const;
+    std::span<const double> GetTermFreqs(uint32_t index) const;
+    SegmentDocument GetDocument(uint32_t index) const;
+
+    // Empty if no document of the segment has the term, deleted documents included.
+    // Ordered by descending term frequency, so every prefix holds the highest scoring postings of the term
+    Postings GetPostings(int term_id) const;
+    // Postings of the term whose document is not deleted, kept up to date by MarkDeleted
+    size_t GetLiveDocumentFrequency(int term_id) const;
+
+private:
+    std::pmr::vector<int> document_ids_;
+    std::pmr::vector<int> ratings_;
+    std::pmr::vector<DocumentStatus> statuses_;
+    std::pmr::vector<uint8_t> deleted_;
+    size_t live_count_ = 0;
+
+    std::pmr::vector<uint32_t> document_term_offsets_;
+    std::pmr::vector<int> document_term_ids_;
+    std::pmr::vector<double> document_term_freqs_;
+
+    std::pmr::vector<int> term_ids_;
+    std::pmr::vector<uint32_t> term_offsets_;
+    std::pmr::vector<uint32_t> term_live_counts_;
+    std::pmr::vector<uint32_t> posting_documents_;
+    std::pmr::vector<double> posting_term_freqs_;
+};
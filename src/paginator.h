@@ -2,6 +2,10 @@
 
 #include <vector>
 #include <iostream>
+#include <iterator>
+#include <algorithm>
+#include <type_traits>
+#include <cstddef>
 
 template <typename Iterator>
 class IteratorRange {
@@ -30,30 +34,166 @@ class IteratorRange {
 template <typename Iterator>
 class Paginator {
 	public:
+        static constexpr bool is_lazy = std::is_base_of_v<std::random_access_iterator_tag,
+        		typename std::iterator_traits<Iterator>::iterator_category>;
+
+        // Computes pages on demand for random-access ranges, so no page table is stored.
+        // Pages are returned by value, so it is a random access iterator only as a C++20 concept
+        class PageIterator {
+            public:
+                using iterator_category = std::input_iterator_tag;
+                using iterator_concept = std::random_access_iterator_tag;
+                using value_type = IteratorRange<Iterator>;
+                using difference_type = std::ptrdiff_t;
+                using pointer = void;
+                using reference = value_type;
+
+                PageIterator() = default;
+
+                PageIterator(const Paginator* paginator, size_t index)
+                	: paginator_(paginator), index_(index)
+                {
+                }
+
+                value_type operator*() const {
+                    return (*paginator_)[index_];
+                }
+
+                value_type operator[](difference_type n) const {
+                    return (*paginator_)[index_ + n];
+                }
+
+                PageIterator& operator++() {
+                    ++index_;
+                    return *this;
+                }
+
+                PageIterator operator++(int) {
+                    PageIterator previous = *this;
+                    ++index_;
+                    return previous;
+                }
+
+                PageIterator& operator--() {
+                    --index_;
+                    return *this;
+                }
+
+                PageIterator operator--(int) {
+                    PageIterator previous = *this;
+                    --index_;
+                    return previous;
+                }
+
+                PageIterator& operator+=(difference_type n) {
+                    index_ += n;
+                    return *this;
+                }
+
+                PageIterator& operator-=(difference_type n) {
+                    index_ -= n;
+                    return *this;
+                }
+
+                PageIterator operator+(difference_type n) const {
+                    return PageIterator(paginator_, index_ + n);
+                }
+
+                friend PageIterator operator+(difference_type n, const PageIterator& iterator) {
+                    return iterator + n;
+                }
+
+                PageIterator operator-(difference_type n) const {
+                    return PageIterator(paginator_, index_ - n);
+                }
+
+                difference_type operator-(const PageIterator& other) const {
+                    return static_cast<difference_type>(index_) - static_cast<difference_type>(other.index_);
+                }
+
+                bool operator==(const PageIterator& other) const {
+                    return index_ == other.index_;
+                }
+
+                bool operator!=(const PageIterator& other) const {
+                    return index_ != other.index_;
+                }
+
+                bool operator<(const PageIterator& other) const {
+                    return index_ < other.index_;
+                }
+
+                bool operator>(const PageIterator& other) const {
+                    return index_ > other.index_;
+                }
+
+                bool operator<=(const PageIterator& other) const {
+                    return index_ <= other.index_;
+                }
+
+                bool operator>=(const PageIterator& other) const {
+                    return index_ >= other.index_;
+                }
+
+            private:
+                const Paginator* paginator_ = nullptr;
+                size_t index_ = 0;
+        };
+
         Paginator(Iterator first, Iterator last, size_t page_size)
+        	: first_(first), last_(last), page_size_(page_size)
         {
-        	for (auto i = first; i != last; std::advance(i, page_size)){
-        		if (std::distance(i, last) > page_size){
-        			pages.emplace_back(i, std::next(i, page_size));
-        	    }else{
-        	    	pages.emplace_back(i, last);
-        	        break;
-        	    }
+        	if constexpr (!is_lazy) {
+        		for (auto i = first; i != last; std::advance(i, page_size)){
+        			if (std::distance(i, last) > page_size){
+        				pages.emplace_back(i, std::next(i, page_size));
+        			}else{
+        				pages.emplace_back(i, last);
+        				break;
+        			}
+        		}
         	}
         }
+
         auto begin() const {
-            return pages.begin();
+        	if constexpr (is_lazy) {
+        		return PageIterator(this, 0);
+        	} else {
+        		return pages.begin();
+        	}
         }
 
-       auto end() const {
-            return pages.end();
+        auto end() const {
+        	if constexpr (is_lazy) {
+        		return PageIterator(this, size());
+        	} else {
+        		return pages.end();
+        	}
         }
 
         size_t size() const {
-            return pages.size();
+        	if constexpr (is_lazy) {
+        		const size_t item_count = std::distance(first_, last_);
+        		return page_size_ == 0 ? 0 : (item_count + page_size_ - 1) / page_size_;
+        	} else {
+        		return pages.size();
+        	}
+        }
+
+        IteratorRange<Iterator> operator[](size_t index) const {
+        	if constexpr (is_lazy) {
+        		const size_t item_count = std::distance(first_, last_);
+        		const size_t page_begin = std::min(index * page_size_, item_count);
+        		const size_t page_end = std::min(page_begin + page_size_, item_count);
+        		return IteratorRange<Iterator>(first_ + page_begin, first_ + page_end);
+        	} else {
+        		return pages[index];
+        	}
         }
 
     private:
+        Iterator first_, last_;
+        size_t page_size_;
         std::vector<IteratorRange<Iterator>> pages;
 };
 
@@ -2,6 +2,16 @@
 
 #include <execution>
 #include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+size_t JoinedDocuments::size() const {
+    return offsets.empty() ? 0 : offsets.size() - 1;
+}
+
+std::span<const Document> JoinedDocuments::GetDocuments(size_t query_index) const {
+    return {documents.data() + offsets[query_index], offsets[query_index + 1] - offsets[query_index]};
+}
 
 std::vector<std::vector<Document>> ProcessQueries(
     const SearchServer& search_server,
@@ -21,11 +31,61 @@ std::vector<std::vector<Document>> ProcessQueries(
 std::vector<Document> ProcessQueriesJoined(
     const SearchServer& search_server,
     const std::vector<std::string>& queries){
-    const auto vec_matched_documents = ProcessQueries(search_server, queries);
-    std::vector<Document> matched_documents_flat;
-    for (const auto& documents : vec_matched_documents){
-    	matched_documents_flat.insert(matched_documents_flat.end(),
-    			documents.begin(), documents.end());
+    return std::move(ProcessQueriesIndexed(search_server, queries).documents);
+}
+
+void ProcessQueriesRange(
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries,
+    size_t first, size_t last,
+    JoinedDocuments& out){
+    if (first > last) {
+    	throw std::invalid_argument("query range ends before it begins");
+    }
+    const size_t count = last - first;
+    // every query owns a fixed stripe of MAX_RESULT_DOCUMENT_COUNT slots, so workers never share memory
+    out.documents.resize(count * MAX_RESULT_DOCUMENT_COUNT);
+    out.offsets.assign(count + 1, 0);
+    std::vector<size_t> indexes(count);
+    std::iota(indexes.begin(), indexes.end(), 0);
+    std::for_each(std::execution::par, indexes.begin(), indexes.end(), [&](size_t index){
+    	const std::span<Document> stripe(out.documents.data() + index * MAX_RESULT_DOCUMENT_COUNT, MAX_RESULT_DOCUMENT_COUNT);
+    	out.offsets[index + 1] = search_server.FindTopDocumentsInto(queries[first + index], stripe);
+    });
+
+    std::inclusive_scan(out.offsets.begin(), out.offsets.end(), out.offsets.begin());
+    // stripes only move left, so a forward pass compacts them in place; stripes already in place are skipped,
+    // as std::copy must not write onto its own source
+    for (size_t index = 0; index < count; ++index){
+    	if (out.offsets[index] == index * MAX_RESULT_DOCUMENT_COUNT) {
+    		continue;
+    	}
+    	std::copy(out.documents.begin() + index * MAX_RESULT_DOCUMENT_COUNT,
+    			out.documents.begin() + index * MAX_RESULT_DOCUMENT_COUNT + (out.offsets[index + 1] - out.offsets[index]),
+    			out.documents.begin() + out.offsets[index]);
     }
-    return matched_documents_flat;
+    out.documents.resize(out.offsets.back());
+}
+
+JoinedDocuments ProcessQueriesIndexed(
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries){
+    JoinedDocuments joined;
+    ProcessQueriesRange(search_server, queries, 0, queries.size(), joined);
+    return joined;
+}
+
+std::vector<Document> ProcessQueriesMerged(
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries){
+    std::vector<Document> documents = ProcessQueriesJoined(search_server, queries);
+    std::sort(std::execution::par, documents.begin(), documents.end(), [](const Document& lhs, const Document& rhs){
+    	return lhs.id < rhs.id || (lhs.id == rhs.id && lhs.relevance > rhs.relevance);
+    });
+    documents.erase(std::unique(documents.begin(), documents.end(), [](const Document& lhs, const Document& rhs){
+    	return lhs.id == rhs.id;
+    }), documents.end());
+    // IsRankedBefore is no strict weak ordering over a whole batch, which std::sort requires
+    std::sort(std::execution::par, documents.begin(), documents.end(), IsRankedBeforeExact);
+    return documents;
 }
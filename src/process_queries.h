@@ -2,9 +2,21 @@
 #include "document.h"
 #include "search_server.h"
 
+#include <algorithm>
+#include <cstddef>
+#include <span>
 #include <string>
 #include <vector>
 
+// Results of a query batch in one flat array: documents of query i are [offsets[i], offsets[i + 1])
+struct JoinedDocuments {
+    std::vector<size_t> offsets;
+    std::vector<Document> documents;
+
+    size_t size() const;
+    std::span<const Document> GetDocuments(size_t query_index) const;
+};
+
 std::vector<std::vector<Document>> ProcessQueries(
     const SearchServer& search_server,
     const std::vector<std::string>& queries);
@@ -12,3 +24,41 @@ std::vector<std::vector<Document>> ProcessQueries(
 std::vector<Document> ProcessQueriesJoined(
     const SearchServer& search_server,
     const std::vector<std::string>& queries);
+
+// Fills results of queries [first, last) in parallel, reusing the buffers of out: every query selects its
+// documents straight into out.documents. Throws std::invalid_argument if first > last
+void ProcessQueriesRange(
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries,
+    size_t first, size_t last,
+    JoinedDocuments& out);
+
+JoinedDocuments ProcessQueriesIndexed(
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries);
+
+// Union of the results of all queries, one entry per document with its best relevance, best ranked first
+std::vector<Document> ProcessQueriesMerged(
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries);
+
+const size_t PROCESS_QUERIES_WINDOW = 4096;
+
+// Calls consumer(query_index, std::span<const Document>) in query order; queries run in parallel
+// windows of window_size, so memory stays bounded by the window however large the batch is
+template <typename Consumer>
+void ProcessQueriesStreamed(
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries,
+    Consumer consumer,
+    size_t window_size = PROCESS_QUERIES_WINDOW) {
+    JoinedDocuments window;
+    window_size = std::max<size_t>(window_size, 1);
+    for (size_t first = 0; first < queries.size(); first += window_size) {
+        const size_t last = std::min(queries.size(), first + window_size);
+        ProcessQueriesRange(search_server, queries, first, last, window);
+        for (size_t i = 0; i < window.size(); ++i) {
+            consumer(first + i, window.GetDocuments(i));
+        }
+    }
+}
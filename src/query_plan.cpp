@@ -0,0 +1,40 @@
+#include "query_plan.h"
+
+namespace {
+
+const char* GetExecutionName(QueryExecution execution) {
+	switch (execution) {
+	case QueryExecution::SEQUENTIAL:
+		return "sequential";
+	case QueryExecution::PARALLEL:
+		return "parallel";
+	case QueryExecution::SHARDED:
+		return "sharded";
+	}
+	return "unknown";
+}
+
+}
+
+std::ostream& operator<<(std::ostream& os, const QueryPlan& plan) {
+	os << "execution = " << GetExecutionName(plan.execution);
+	if (plan.execution == QueryExecution::SHARDED) {
+		os << " x" << plan.shard_count;
+	}
+	if (plan.dense_scores) {
+		os << " (dense scores)";
+	}
+	os << ", estimated postings = " << plan.estimated_postings
+	   << ", excluded documents = " << plan.excluded_documents << std::endl;
+	for (const QueryPlan::Term& term : plan.plus_terms) {
+		os << "  + " << term.word << " (documents = " << term.document_count
+		   << ", idf = " << term.inverse_document_freq << ")" << std::endl;
+	}
+	for (const QueryPlan::Term& term : plan.minus_terms) {
+		os << "  - " << term.word << " (documents = " << term.document_count << ")" << std::endl;
+	}
+	for (const std::string_view word : plan.absent_words) {
+		os << "  x " << word << " (not indexed)" << std::endl;
+	}
+	return os;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <iostream>
+#include <string_view>
+#include <vector>
+
+enum class QueryExecution {
+    SEQUENTIAL,
+    PARALLEL,
+    SHARDED,
+};
+
+// Execution plan of a query; words are views into the raw query text
+struct QueryPlan {
+    struct Term {
+        std::string_view word;
+        size_t document_count = 0;
+        double inverse_document_freq = 0.0;
+    };
+
+    std::vector<Term> plus_terms;
+    std::vector<Term> minus_terms;
+    std::vector<std::string_view> absent_words;
+    size_t estimated_postings = 0;
+    size_t excluded_documents = 0;
+    size_t shard_count = 1;
+    QueryExecution execution = QueryExecution::SEQUENTIAL;
+    bool dense_scores = false;
+};
+
+std::ostream& operator<<(std::ostream& os, const QueryPlan& plan);
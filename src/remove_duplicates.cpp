@@ -1,21 +1,17 @@
 #include "remove_duplicates.h"
 
-#include <string>
-#include <set>
 #include <map>
 #include <iostream>
 #include <vector>
 
 void RemoveDuplicates(SearchServer& search_server){
-    std::map<std::set<std::string>, int> document_id_to_words;
+    // documents with the same set of words have the same sorted term ids
+    std::map<std::vector<int>, int> document_id_to_words;
     std::vector<int> ids_to_remove;
 
     for (const auto& document_id : search_server){
-    	std::set<std::string> words;
-        for (const auto& [word, _] : search_server.GetWordFrequencies(document_id)){
-        	words.insert({word.begin(), word.end()});
-        }
-        if (!document_id_to_words.try_emplace(words, document_id).second){
+    	const auto term_ids = search_server.GetWordFrequencies(document_id).GetTermIds();
+        if (!document_id_to_words.try_emplace(std::vector<int>(term_ids.begin(), term_ids.end()), document_id).second){
             ids_to_remove.push_back(document_id);
         }
     }
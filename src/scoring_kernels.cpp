@@ -0,0 +1,248 @@
+#include "scoring_kernels.h"
+
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define SCORING_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+// -ffp-contract=fast (GCC's default outside ISO mode) would fuse the multiply and add into FMA in some variants only;
+// the pragma covers this file alone, the rest of the tree relies on -ffp-contract=off on the command line
+#pragma GCC optimize("fp-contract=off")
+
+namespace {
+
+struct ScoringKernels {
+	ScoringIsa isa;
+	void (*accumulate)(double*, const uint32_t*, const double*, size_t, double);
+	void (*block_maxima)(const double*, size_t, double*);
+	size_t (*collect)(const double*, const uint8_t*, size_t, double, uint32_t*);
+};
+
+void AccumulateScoresScalar(double* scores, const uint32_t* slots, const double* term_freqs, size_t count,
+		double inverse_document_freq) {
+	for (size_t i = 0; i < count; ++i) {
+		const double score = term_freqs[i] * inverse_document_freq;
+		scores[slots[i]] += score;
+	}
+}
+
+void ComputeBlockMaximaScalar(const double* scores, size_t count, double* maxima) {
+	for (size_t begin = 0; begin < count; begin += SCORING_BLOCK_SIZE) {
+		*maxima++ = *std::max_element(scores + begin, scores + std::min(begin + SCORING_BLOCK_SIZE, count));
+	}
+}
+
+size_t CollectCandidatesScalar(const double* scores, const uint8_t* matched, size_t count, double threshold,
+		uint32_t* candidates) {
+	size_t found = 0;
+	for (size_t i = 0; i < count; ++i) {
+		if (matched[i] && scores[i] >= threshold) {
+			candidates[found++] = static_cast<uint32_t>(i);
+		}
+	}
+	return found;
+}
+
+#ifdef SCORING_KERNELS_X86
+
+size_t CollectMask(unsigned mask, const uint8_t* matched, size_t base, uint32_t* candidates) {
+	size_t found = 0;
+	while (mask != 0) {
+		const unsigned bit = __builtin_ctz(mask);
+		mask &= mask - 1;
+		if (matched[base + bit]) {
+			candidates[found++] = static_cast<uint32_t>(base + bit);
+		}
+	}
+	return found;
+}
+
+__attribute__((target("avx2")))
+void AccumulateScoresAvx2(double* scores, const uint32_t* slots, const double* term_freqs, size_t count,
+		double inverse_document_freq) {
+	const __m256d idf = _mm256_set1_pd(inverse_document_freq);
+	size_t i = 0;
+	alignas(32) double updated[4];
+	for (; i + 4 <= count; i += 4) {
+		const __m128i index = _mm_loadu_si128(reinterpret_cast<const __m128i*>(slots + i));
+		const __m256d current = _mm256_mask_i32gather_pd(_mm256_setzero_pd(), scores, index,
+				_mm256_castsi256_pd(_mm256_set1_epi64x(-1)), sizeof(double));
+		const __m256d score = _mm256_mul_pd(_mm256_loadu_pd(term_freqs + i), idf);
+		_mm256_store_pd(updated, _mm256_add_pd(current, score));
+		scores[slots[i]] = updated[0];
+		scores[slots[i + 1]] = updated[1];
+		scores[slots[i + 2]] = updated[2];
+		scores[slots[i + 3]] = updated[3];
+	}
+	AccumulateScoresScalar(scores, slots + i, term_freqs + i, count - i, inverse_document_freq);
+}
+
+__attribute__((target("avx2")))
+void ComputeBlockMaximaAvx2(const double* scores, size_t count, double* maxima) {
+	size_t begin = 0;
+	for (; begin + SCORING_BLOCK_SIZE <= count; begin += SCORING_BLOCK_SIZE) {
+		const __m256d pair_max = _mm256_max_pd(_mm256_loadu_pd(scores + begin), _mm256_loadu_pd(scores + begin + 4));
+		const __m128d half_max = _mm_max_pd(_mm256_castpd256_pd128(pair_max), _mm256_extractf128_pd(pair_max, 1));
+		*maxima++ = _mm_cvtsd_f64(_mm_max_sd(half_max, _mm_unpackhi_pd(half_max, half_max)));
+	}
+	ComputeBlockMaximaScalar(scores + begin, count - begin, maxima);
+}
+
+__attribute__((target("avx2")))
+size_t CollectCandidatesAvx2(const double* scores, const uint8_t* matched, size_t count, double threshold,
+		uint32_t* candidates) {
+	const __m256d limit = _mm256_set1_pd(threshold);
+	size_t found = 0;
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		const unsigned mask = _mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(scores + i), limit, _CMP_GE_OQ));
+		found += CollectMask(mask, matched, i, candidates + found);
+	}
+	const size_t tail = CollectCandidatesScalar(scores + i, matched + i, count - i, threshold, candidates + found);
+	for (size_t j = found; j < found + tail; ++j) {
+		candidates[j] += static_cast<uint32_t>(i);
+	}
+	return found + tail;
+}
+
+__attribute__((target("avx512f")))
+void AccumulateScoresAvx512(double* scores, const uint32_t* slots, const double* term_freqs, size_t count,
+		double inverse_document_freq) {
+	const __m512d idf = _mm512_set1_pd(inverse_document_freq);
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		const __m256i index = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(slots + i));
+		const __m512d current = _mm512_mask_i32gather_pd(_mm512_setzero_pd(), 0xFF, index, scores, sizeof(double));
+		const __m512d score = _mm512_mul_pd(_mm512_loadu_pd(term_freqs + i), idf);
+		_mm512_i32scatter_pd(scores, index, _mm512_add_pd(current, score), sizeof(double));
+	}
+	AccumulateScoresScalar(scores, slots + i, term_freqs + i, count - i, inverse_document_freq);
+}
+
+__attribute__((target("avx512f")))
+void ComputeBlockMaximaAvx512(const double* scores, size_t count, double* maxima) {
+	size_t begin = 0;
+	for (; begin + SCORING_BLOCK_SIZE <= count; begin += SCORING_BLOCK_SIZE) {
+		// the block is loaded as two halves: _mm512_reduce_max_pd and the 512 to 256 bit extracts leave lanes
+		// undefined, which GCC reports as -Wmaybe-uninitialized
+		const __m256d quad_max = _mm256_max_pd(_mm256_loadu_pd(scores + begin), _mm256_loadu_pd(scores + begin + 4));
+		const __m128d half_max = _mm_max_pd(_mm256_castpd256_pd128(quad_max), _mm256_extractf128_pd(quad_max, 1));
+		*maxima++ = _mm_cvtsd_f64(_mm_max_sd(half_max, _mm_unpackhi_pd(half_max, half_max)));
+	}
+	ComputeBlockMaximaScalar(scores + begin, count - begin, maxima);
+}
+
+__attribute__((target("avx512f")))
+size_t CollectCandidatesAvx512(const double* scores, const uint8_t* matched, size_t count, double threshold,
+		uint32_t* candidates) {
+	const __m512d limit = _mm512_set1_pd(threshold);
+	size_t found = 0;
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		const __mmask8 mask = _mm512_cmp_pd_mask(_mm512_loadu_pd(scores + i), limit, _CMP_GE_OQ);
+		found += CollectMask(mask, matched, i, candidates + found);
+	}
+	const size_t tail = CollectCandidatesScalar(scores + i, matched + i, count - i, threshold, candidates + found);
+	for (size_t j = found; j < found + tail; ++j) {
+		candidates[j] += static_cast<uint32_t>(i);
+	}
+	return found + tail;
+}
+
+#endif
+
+const ScoringKernels SCALAR_KERNELS = {
+	ScoringIsa::SCALAR, AccumulateScoresScalar, ComputeBlockMaximaScalar, CollectCandidatesScalar};
+
+#ifdef SCORING_KERNELS_X86
+const ScoringKernels AVX2_KERNELS = {
+	ScoringIsa::AVX2, AccumulateScoresAvx2, ComputeBlockMaximaAvx2, CollectCandidatesAvx2};
+const ScoringKernels AVX512_KERNELS = {
+	ScoringIsa::AVX512, AccumulateScoresAvx512, ComputeBlockMaximaAvx512, CollectCandidatesAvx512};
+#endif
+
+bool IsSupported(ScoringIsa isa) {
+	switch (isa) {
+	case ScoringIsa::SCALAR:
+		return true;
+#ifdef SCORING_KERNELS_X86
+	case ScoringIsa::AVX2:
+		return __builtin_cpu_supports("avx2");
+	case ScoringIsa::AVX512:
+		return __builtin_cpu_supports("avx512f");
+#endif
+	default:
+		return false;
+	}
+}
+
+const ScoringKernels* GetKernels(ScoringIsa isa) {
+	switch (isa) {
+#ifdef SCORING_KERNELS_X86
+	case ScoringIsa::AVX2:
+		return &AVX2_KERNELS;
+	case ScoringIsa::AVX512:
+		return &AVX512_KERNELS;
+#endif
+	default:
+		return &SCALAR_KERNELS;
+	}
+}
+
+std::atomic<const ScoringKernels*>& GetActiveKernels() {
+	static std::atomic<const ScoringKernels*> active(GetKernels(GetBestScoringIsa()));
+	return active;
+}
+
+}
+
+ScoringIsa GetScoringIsa() {
+	return GetActiveKernels().load(std::memory_order_relaxed)->isa;
+}
+
+ScoringIsa GetBestScoringIsa() {
+	if (IsSupported(ScoringIsa::AVX512)) {
+		return ScoringIsa::AVX512;
+	}
+	if (IsSupported(ScoringIsa::AVX2)) {
+		return ScoringIsa::AVX2;
+	}
+	return ScoringIsa::SCALAR;
+}
+
+void SetScoringIsa(ScoringIsa isa) {
+	if (!IsSupported(isa)) {
+		throw std::invalid_argument("instruction set is not supported by this CPU");
+	}
+	GetActiveKernels().store(GetKernels(isa), std::memory_order_relaxed);
+}
+
+const char* GetScoringIsaName(ScoringIsa isa) {
+	switch (isa) {
+	case ScoringIsa::SCALAR:
+		return "scalar";
+	case ScoringIsa::AVX2:
+		return "avx2";
+	case ScoringIsa::AVX512:
+		return "avx512";
+	}
+	return "unknown";
+}
+
+void AccumulateScores(double* scores, const uint32_t* slots, const double* term_freqs, size_t count,
+		double inverse_document_freq) {
+	GetActiveKernels().load(std::memory_order_relaxed)->accumulate(scores, slots, term_freqs, count, inverse_document_freq);
+}
+
+void ComputeBlockMaxima(const double* scores, size_t count, double* maxima) {
+	GetActiveKernels().load(std::memory_order_relaxed)->block_maxima(scores, count, maxima);
+}
+
+size_t CollectCandidates(const double* scores, const uint8_t* matched, size_t count, double threshold,
+		uint32_t* candidates) {
+	return GetActiveKernels().load(std::memory_order_relaxed)->collect(scores, matched, count, threshold, candidates);
+}
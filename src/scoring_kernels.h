@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Kernels over dense score arrays, dispatched at runtime to the best instruction set of the CPU.
+// Every variant multiplies and adds separately without FMA, so scores are bit-identical across them; they match the
+// map based scoring of SearchServer bit for bit only when that is built with -ffp-contract=off as the readme requires.
+enum class ScoringIsa {
+    SCALAR,
+    AVX2,
+    AVX512,
+};
+
+const size_t SCORING_BLOCK_SIZE = 8;
+
+ScoringIsa GetScoringIsa();
+ScoringIsa GetBestScoringIsa();
+// Selects a variant, e.g. for benchmarking; throws std::invalid_argument if the CPU lacks it
+void SetScoringIsa(ScoringIsa isa);
+const char* GetScoringIsaName(ScoringIsa isa);
+
+// scores[slots[i]] += term_freqs[i] * inverse_document_freq; slots must be unique within one call
+void AccumulateScores(double* scores, const uint32_t* slots, const double* term_freqs, size_t count,
+		double inverse_document_freq);
+
+// Writes the maximum of every SCORING_BLOCK_SIZE scores, (count + SCORING_BLOCK_SIZE - 1) / SCORING_BLOCK_SIZE values
+void ComputeBlockMaxima(const double* scores, size_t count, double* maxima);
+
+// Writes the slots with matched[slot] != 0 and scores[slot] >= threshold, returns how many
+size_t CollectCandidates(const double* scores, const uint8_t* matched, size_t count, double threshold,
+		uint32_t* candidates);
@@ -0,0 +1,157 @@
+#include "search_client.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+const size_t READ_CHUNK_SIZE = 64 << 10;
+
+std::system_error MakeSystemError(const std::string& what) {
+    return std::system_error(errno, std::generic_category(), what);
+}
+
+}
+
+SearchClient::SearchClient(const std::string& unix_path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (unix_path.size() >= sizeof(address.sun_path)) {
+    	throw std::invalid_argument("unix socket path is too long");
+    }
+    std::memcpy(address.sun_path, unix_path.c_str(), unix_path.size() + 1);
+    fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd_ < 0) {
+    	throw MakeSystemError("socket");
+    }
+    if (connect(fd_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0) {
+    	const std::system_error error = MakeSystemError("connect " + unix_path);
+    	close(fd_);
+    	throw error;
+    }
+}
+
+SearchClient::SearchClient(uint16_t tcp_port) {
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(tcp_port);
+    fd_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd_ < 0) {
+    	throw MakeSystemError("socket");
+    }
+    if (connect(fd_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0) {
+    	const std::system_error error = MakeSystemError("connect 127.0.0.1:" + std::to_string(tcp_port));
+    	close(fd_);
+    	throw error;
+    }
+    const int enable = 1;
+    setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+}
+
+SearchClient::~SearchClient() {
+    close(fd_);
+}
+
+uint32_t SearchClient::Send(SearchRequest request) {
+    request.request_id = next_request_id_++;
+    AppendRequest(output_, request);
+    return request.request_id;
+}
+
+void SearchClient::Flush() {
+    size_t offset = 0;
+    while (offset < output_.size()) {
+    	const ssize_t written = send(fd_, output_.data() + offset, output_.size() - offset, MSG_NOSIGNAL);
+    	if (written < 0) {
+    		if (errno == EINTR) {
+    			continue;
+    		}
+    		throw MakeSystemError("send");
+    	}
+    	offset += written;
+    }
+    output_.clear();
+}
+
+SearchResponse SearchClient::Receive() {
+    Flush();
+    while (true) {
+    	if (const size_t frame_size = GetFrameSize(input_)) {
+    		SearchResponse response = DecodeResponse(std::string_view(input_).substr(0, frame_size));
+    		input_.erase(0, frame_size);
+    		return response;
+    	}
+    	const size_t size = input_.size();
+    	input_.resize(size + READ_CHUNK_SIZE);
+    	const ssize_t bytes_read = read(fd_, input_.data() + size, READ_CHUNK_SIZE);
+    	input_.resize(size + std::max<ssize_t>(bytes_read, 0));
+    	if (bytes_read < 0) {
+    		if (errno == EINTR) {
+    			continue;
+    		}
+    		throw MakeSystemError("read");
+    	}
+    	if (bytes_read == 0) {
+    		throw std::runtime_error("search daemon closed the connection");
+    	}
+    }
+}
+
+SearchResponse SearchClient::RoundTrip(SearchRequest request) {
+    const uint32_t request_id = Send(std::move(request));
+    SearchResponse response = Receive();
+    if (response.request_id != request_id) {
+    	throw std::runtime_error("response does not match the request, pipelined responses are pending");
+    }
+    if (!response.error.empty()) {
+    	throw std::runtime_error(response.error);
+    }
+    return response;
+}
+
+std::vector<Document> SearchClient::FindTopDocuments(const std::string& raw_query, DocumentStatus status) {
+    SearchRequest request;
+    request.opcode = SearchOpcode::FIND_TOP_DOCUMENTS;
+    request.status = status;
+    request.text = raw_query;
+    return RoundTrip(std::move(request)).documents;
+}
+
+std::tuple<std::vector<std::string>, DocumentStatus> SearchClient::MatchDocument(const std::string& raw_query, int document_id) {
+    SearchRequest request;
+    request.opcode = SearchOpcode::MATCH_DOCUMENT;
+    request.document_id = document_id;
+    request.text = raw_query;
+    SearchResponse response = RoundTrip(std::move(request));
+    return {std::move(response.words), response.status};
+}
+
+void SearchClient::AddDocument(int document_id, const std::string& document, DocumentStatus status,
+		const std::vector<int>& ratings) {
+    SearchRequest request;
+    request.opcode = SearchOpcode::ADD_DOCUMENT;
+    request.document_id = document_id;
+    request.status = status;
+    request.text = document;
+    request.ratings = ratings;
+    RoundTrip(std::move(request));
+}
+
+void SearchClient::RemoveDocument(int document_id) {
+    SearchRequest request;
+    request.opcode = SearchOpcode::REMOVE_DOCUMENT;
+    request.document_id = document_id;
+    RoundTrip(std::move(request));
+}
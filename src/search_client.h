@@ -0,0 +1,41 @@
+#pragma once
+
+#include "search_protocol.h"
+
+#include <cstdint>
+#include <string>
+#include <tuple>
+#include <vector>
+
+// Blocking client of SearchDaemon. Send only buffers, so several requests can be pipelined
+// before their responses are read with Receive in the same order
+class SearchClient {
+public:
+    explicit SearchClient(const std::string& unix_path);
+    explicit SearchClient(uint16_t tcp_port);
+
+    SearchClient(const SearchClient&) = delete;
+    SearchClient& operator=(const SearchClient&) = delete;
+
+    ~SearchClient();
+
+    // Returns the request id
+    uint32_t Send(SearchRequest request);
+    void Flush();
+    // Flushes pending requests first
+    SearchResponse Receive();
+
+    // Round trips; throw std::runtime_error with the server message if the request failed
+    std::vector<Document> FindTopDocuments(const std::string& raw_query, DocumentStatus status = DocumentStatus::ACTUAL);
+    std::tuple<std::vector<std::string>, DocumentStatus> MatchDocument(const std::string& raw_query, int document_id);
+    void AddDocument(int document_id, const std::string& document, DocumentStatus status, const std::vector<int>& ratings);
+    void RemoveDocument(int document_id);
+
+private:
+    int fd_ = -1;
+    uint32_t next_request_id_ = 1;
+    std::string output_;
+    std::string input_;
+
+    SearchResponse RoundTrip(SearchRequest request);
+};
@@ -0,0 +1,54 @@
+#include "search_collections.h"
+
+#include <stdexcept>
+#include <utility>
+
+SearchCollections::SearchCollections(std::shared_ptr<SearchContext> context)
+	: context_(RequireContext(std::move(context)))
+{
+}
+
+SearchServer& SearchCollections::CreateCollection(const std::string_view& name) {
+	const auto [it, inserted] = collections_.try_emplace(std::string(name), context_);
+	if (!inserted) {
+		throw std::invalid_argument("collection already exists");
+	}
+	return it->second;
+}
+
+SearchServer& SearchCollections::GetCollection(const std::string_view& name) {
+	const auto it = collections_.find(name);
+	if (it == collections_.end()) {
+		throw std::out_of_range("collection does not exist");
+	}
+	return it->second;
+}
+
+const SearchServer& SearchCollections::GetCollection(const std::string_view& name) const {
+	const auto it = collections_.find(name);
+	if (it == collections_.end()) {
+		throw std::out_of_range("collection does not exist");
+	}
+	return it->second;
+}
+
+bool SearchCollections::HasCollection(const std::string_view& name) const {
+	return collections_.find(name) != collections_.end();
+}
+
+bool SearchCollections::DropCollection(const std::string_view& name) {
+	const auto it = collections_.find(name);
+	if (it == collections_.end()) {
+		return false;
+	}
+	collections_.erase(it);
+	return true;
+}
+
+size_t SearchCollections::GetCollectionCount() const {
+	return collections_.size();
+}
+
+const std::shared_ptr<SearchContext>& SearchCollections::GetContext() const {
+	return context_;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "search_context.h"
+#include "search_server.h"
+
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+
+// Named collections, e.g. one per tenant, each a SearchServer with its own documents, postings and IDF,
+// sharing stop words, the term dictionary, the memory pool and the parallel query budget
+class SearchCollections {
+public:
+    explicit SearchCollections(std::shared_ptr<SearchContext> context);
+
+    template <typename StringContainer>
+    explicit SearchCollections(const StringContainer& stop_words,
+    		std::pmr::memory_resource* upstream = std::pmr::new_delete_resource())
+    : SearchCollections(std::make_shared<SearchContext>(stop_words, upstream))
+    {
+    }
+
+    // Throws std::invalid_argument if a collection with the name already exists
+    SearchServer& CreateCollection(const std::string_view& name);
+    // Throw std::out_of_range if there is no collection with the name
+    SearchServer& GetCollection(const std::string_view& name);
+    const SearchServer& GetCollection(const std::string_view& name) const;
+    bool HasCollection(const std::string_view& name) const;
+    // Returns false if there is no collection with the name; terms no other collection holds leave the dictionary
+    bool DropCollection(const std::string_view& name);
+    size_t GetCollectionCount() const;
+    const std::shared_ptr<SearchContext>& GetContext() const;
+
+private:
+    std::shared_ptr<SearchContext> context_;
+    std::map<std::string, SearchServer, std::less<>> collections_;
+};
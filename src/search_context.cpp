@@ -0,0 +1,183 @@
+#include "search_context.h"
+
+#include <limits>
+#include <mutex>
+#include <tuple>
+#include <utility>
+
+TermDictionary::TermDictionary(std::pmr::memory_resource* resource)
+	: terms_(resource)
+	, terms_by_id_(resource)
+{
+}
+
+TermDictionary::Term TermDictionary::Intern(const std::string_view& word) {
+	{
+		// a listed term has a reference, so the count is raised without excluding Release
+		std::shared_lock lock(mutex_);
+		if (const auto it = terms_.find(word); it != terms_.end()) {
+			it->second.references.fetch_add(1, std::memory_order_relaxed);
+			return {it->second.id, it->first};
+		}
+	}
+	std::unique_lock lock(mutex_);
+	auto it = terms_.find(word);
+	if (it != terms_.end()) {
+		it->second.references.fetch_add(1, std::memory_order_relaxed);
+		return {it->second.id, it->first};
+	}
+	if (next_id_ == std::numeric_limits<int>::max()) {
+		throw std::length_error("term dictionary is out of ids");
+	}
+	it = terms_.emplace(std::piecewise_construct, std::forward_as_tuple(word), std::forward_as_tuple(next_id_)).first;
+	terms_by_id_.emplace(next_id_++, it);
+	return {it->second.id, it->first};
+}
+
+void TermDictionary::Release(int term_id) {
+	std::unique_lock lock(mutex_);
+	const auto it = terms_by_id_.find(term_id);
+	if (it == terms_by_id_.end()) {
+		return;
+	}
+	if (it->second->second.references.fetch_sub(1, std::memory_order_relaxed) == 1) {
+		terms_.erase(it->second);
+		terms_by_id_.erase(it);
+	}
+}
+
+std::optional<TermDictionary::Term> TermDictionary::Find(const std::string_view& word) const {
+	std::shared_lock lock(mutex_);
+	const auto it = terms_.find(word);
+	if (it == terms_.end()) {
+		return std::nullopt;
+	}
+	return Term{it->second.id, it->first};
+}
+
+size_t TermDictionary::size() const {
+	std::shared_lock lock(mutex_);
+	return terms_.size();
+}
+
+SearchContext::ParallelPermit::ParallelPermit(const SearchContext* context)
+	: context_(context)
+{
+}
+
+SearchContext::ParallelPermit::ParallelPermit(ParallelPermit&& other) noexcept
+	: context_(std::exchange(other.context_, nullptr))
+{
+}
+
+SearchContext::ParallelPermit& SearchContext::ParallelPermit::operator=(ParallelPermit&& other) noexcept {
+	if (this != &other) {
+		if (context_) {
+			context_->parallel_queries_.fetch_sub(1, std::memory_order_release);
+		}
+		context_ = std::exchange(other.context_, nullptr);
+	}
+	return *this;
+}
+
+SearchContext::ParallelPermit::~ParallelPermit() {
+	if (context_) {
+		context_->parallel_queries_.fetch_sub(1, std::memory_order_release);
+	}
+}
+
+SearchContext::ParallelPermit::operator bool() const {
+	return context_ != nullptr;
+}
+
+bool SearchContext::IsStopWord(const std::string_view& word) const {
+	return stop_words_.Contains(word);
+}
+
+std::vector<std::string_view> SearchContext::SplitIntoWordsNoStop(std::string_view text) const {
+	std::vector<std::string_view> words;
+	const uint64_t seed = stop_words_.GetSeed();
+	uint64_t hash = seed;
+	size_t word_begin = 0;
+	for (size_t i = 0; i <= text.size(); ++i) {
+		if (i < text.size() && text[i] != ' ') {
+			// the stop word hash is computed in the same pass that looks for the word end
+			hash = StopWordSet::HashStep(hash, text[i]);
+			continue;
+		}
+		const std::string_view word = text.substr(word_begin, i - word_begin);
+		if (!word.empty() && !stop_words_.Contains(word, hash)) {
+			words.push_back(word);
+		}
+		word_begin = i + 1;
+		hash = seed;
+	}
+	return words;
+}
+
+TermDictionary& SearchContext::GetTerms() {
+	return terms_;
+}
+
+const TermDictionary& SearchContext::GetTerms() const {
+	return terms_;
+}
+
+std::pmr::memory_resource* SearchContext::GetResource() {
+	return &index_resource_;
+}
+
+SearchContext::ParallelPermit SearchContext::TryAcquireParallel() const {
+	if (parallel_queries_.fetch_add(1, std::memory_order_acquire) >= max_parallel_queries_) {
+		parallel_queries_.fetch_sub(1, std::memory_order_release);
+		return ParallelPermit();
+	}
+	return ParallelPermit(this);
+}
+
+SearchContext::QueryWord SearchContext::ParseQueryWord(std::string_view text) const {
+    bool is_minus = false;
+    if (text[0] == '-') {
+    	is_minus = true;
+    	text = text.substr(1);
+    }
+    if (text.empty() || text[0] == '-'){
+    	throw std::invalid_argument("Wrong value of minus word");
+    }
+    return { text, is_minus, IsStopWord(text) };
+}
+
+SearchQuery SearchContext::ParseQuery(const std::string_view& text) const {
+    SearchQuery query;
+    for (const std::string_view& word : SplitIntoWordsView(text)){
+    	if (IsValidWord(word)){
+    		const QueryWord query_word = ParseQueryWord(word);
+    		if (query_word.is_stop){
+    			continue;
+    		}
+    		if (query_word.is_minus){
+    			query.minus_words.insert(query_word.data);
+    		}else{
+    			query.plus_words.insert(query_word.data);
+    		}
+    	}else{
+    		throw std::invalid_argument("Word has illegal characters");
+    	}
+    }
+    return query;
+}
+
+MemoryStats SearchContext::GetIndexMemoryStats() const {
+	return index_resource_.GetStats();
+}
+
+MemoryStats SearchContext::GetReservedMemoryStats() const {
+	return reserved_resource_.GetStats();
+}
+
+std::shared_ptr<SearchContext> RequireContext(std::shared_ptr<SearchContext> context) {
+    if (!context) {
+    	throw std::invalid_argument("search context is null");
+    }
+    return context;
+}
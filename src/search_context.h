@@ -0,0 +1,146 @@
+#pragma once
+
+#include "string_processing.h"
+#include "counting_memory_resource.h"
+#include "stop_word_set.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <set>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Interns index terms: every term is stored once with a count of references, one per indexed document
+// holding it, and is erased with its last reference. Ids are never reused, so a stale id matches no term
+class TermDictionary {
+public:
+    struct Term {
+        int id;
+        std::string_view data;
+    };
+
+    explicit TermDictionary(std::pmr::memory_resource* resource);
+
+    // Adds a reference, creating the term on first use; pair every Intern with a Release.
+    // Throws std::length_error once all int ids have been handed out
+    Term Intern(const std::string_view& word);
+    // Drops a reference; data of the last released term is freed
+    void Release(int term_id);
+    // Takes no reference: data stays valid while some index holds the term
+    std::optional<Term> Find(const std::string_view& word) const;
+    // Terms with at least one reference
+    size_t size() const;
+
+private:
+    struct Entry {
+        explicit Entry(int id)
+        	: id(id)
+        	, references(1)
+        {
+        }
+
+        const int id;
+        std::atomic<size_t> references;
+    };
+    using Terms = std::pmr::map<std::pmr::string, Entry, std::less<>>;
+
+    mutable std::shared_mutex mutex_;
+    Terms terms_;
+    std::pmr::map<int, Terms::iterator> terms_by_id_;
+    int next_id_ = 0;
+};
+
+// Plus and minus words of a query without stop words, views into the query text
+struct SearchQuery {
+    std::set<std::string_view> plus_words;
+    std::set<std::string_view> minus_words;
+};
+
+// State shared by every SearchServer built on it: stop words, term dictionary, memory pool
+// and a budget of queries allowed to run on the parallel policy at the same time
+class SearchContext {
+public:
+    // Releases its share of the parallel budget on destruction
+    class ParallelPermit {
+    public:
+        ParallelPermit() = default;
+        explicit ParallelPermit(const SearchContext* context);
+        ParallelPermit(ParallelPermit&& other) noexcept;
+        ParallelPermit& operator=(ParallelPermit&& other) noexcept;
+        ~ParallelPermit();
+
+        explicit operator bool() const;
+
+    private:
+        const SearchContext* context_ = nullptr;
+    };
+
+    template <typename StringContainer>
+    explicit SearchContext(const StringContainer& stop_words,
+    		std::pmr::memory_resource* upstream = std::pmr::new_delete_resource(),
+    		size_t max_parallel_queries = std::max(1u, std::thread::hardware_concurrency()))
+    : stop_words_(MakeUniqueNonEmptyStrings(stop_words))
+    , reserved_resource_(upstream)
+    , pool_resource_(&reserved_resource_)
+    , index_resource_(&pool_resource_)
+    , terms_(&index_resource_)
+    , max_parallel_queries_(max_parallel_queries)
+    {
+        for (const auto& stop_word : stop_words_.GetWords()){
+            if (!IsValidWord(stop_word)){
+                throw std::invalid_argument("stop words are invalid");
+            }
+        }
+    }
+
+    SearchContext(const SearchContext&) = delete;
+    SearchContext& operator=(const SearchContext&) = delete;
+
+    bool IsStopWord(const std::string_view& word) const;
+    // Splits text on spaces dropping empty words and stop words, views into text
+    std::vector<std::string_view> SplitIntoWordsNoStop(std::string_view text) const;
+    // Throws std::invalid_argument for words with control characters and malformed minus words
+    SearchQuery ParseQuery(const std::string_view& text) const;
+    TermDictionary& GetTerms();
+    const TermDictionary& GetTerms() const;
+    std::pmr::memory_resource* GetResource();
+
+    // Empty when max_parallel_queries queries are already running in parallel
+    ParallelPermit TryAcquireParallel() const;
+
+    // Bytes requested by the index containers of all servers on this context
+    MemoryStats GetIndexMemoryStats() const;
+    // Bytes the pool holds from the upstream resource
+    MemoryStats GetReservedMemoryStats() const;
+
+private:
+    struct QueryWord {
+        std::string_view data;
+        bool is_minus;
+        bool is_stop;
+    };
+
+    const StopWordSet stop_words_;
+    CountingMemoryResource reserved_resource_;
+    std::pmr::synchronized_pool_resource pool_resource_;
+    CountingMemoryResource index_resource_;
+    TermDictionary terms_;
+    const size_t max_parallel_queries_;
+    mutable std::atomic<size_t> parallel_queries_ = 0;
+
+    QueryWord ParseQueryWord(std::string_view text) const;
+};
+
+// Returns context for a mem-initializer, so members built from it never see null;
+// throws std::invalid_argument if it is null
+std::shared_ptr<SearchContext> RequireContext(std::shared_ptr<SearchContext> context);
@@ -0,0 +1,462 @@
+#include "search_daemon.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <execution>
+#include <stdexcept>
+#include <system_error>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+const uint64_t LISTEN_ID = 0;
+const uint64_t STOP_ID = 1;
+const uint64_t DURABLE_ID = 2;
+const size_t READ_CHUNK_SIZE = 64 << 10;
+const int MAX_EVENTS = 256;
+
+std::system_error MakeSystemError(const std::string& what) {
+    return std::system_error(errno, std::generic_category(), what);
+}
+
+}
+
+SearchDaemon::SearchDaemon(SearchServer& search_server, const SearchDaemonOptions& options, IndexLog* index_log)
+	: search_server_(search_server)
+	, options_(options)
+	, index_log_(index_log)
+{
+    if (options_.max_batch_size == 0) {
+    	throw std::invalid_argument("batch size must be positive");
+    }
+    if (options_.max_read_per_wakeup == 0 || options_.max_unanswered_requests == 0) {
+    	throw std::invalid_argument("read limits must be positive");
+    }
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ < 0) {
+    	throw MakeSystemError("epoll_create1");
+    }
+    stop_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (stop_fd_ < 0) {
+    	const std::system_error error = MakeSystemError("eventfd");
+    	close(epoll_fd_);
+    	throw error;
+    }
+    try {
+    	Listen();
+    	if (index_log_ != nullptr) {
+    		epoll_event event{};
+    		event.events = EPOLLIN;
+    		event.data.u64 = DURABLE_ID;
+    		if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, index_log_->GetDurableEventFd(), &event) < 0) {
+    			throw MakeSystemError("epoll_ctl");
+    		}
+    	}
+    } catch (...) {
+    	if (listen_fd_ >= 0) {
+    		close(listen_fd_);
+    	}
+    	close(stop_fd_);
+    	close(epoll_fd_);
+    	throw;
+    }
+}
+
+SearchDaemon::~SearchDaemon() {
+    for (const auto& [_, connection] : connections_) {
+    	close(connection.fd);
+    }
+    close(listen_fd_);
+    close(stop_fd_);
+    close(epoll_fd_);
+    if (!options_.unix_path.empty()) {
+    	unlink(options_.unix_path.c_str());
+    }
+}
+
+void SearchDaemon::Listen() {
+    if (!options_.unix_path.empty()) {
+    	sockaddr_un address{};
+    	address.sun_family = AF_UNIX;
+    	if (options_.unix_path.size() >= sizeof(address.sun_path)) {
+    		throw std::invalid_argument("unix socket path is too long");
+    	}
+    	std::memcpy(address.sun_path, options_.unix_path.c_str(), options_.unix_path.size() + 1);
+    	listen_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    	if (listen_fd_ < 0) {
+    		throw MakeSystemError("socket");
+    	}
+    	unlink(options_.unix_path.c_str());
+    	if (bind(listen_fd_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0) {
+    		throw MakeSystemError("bind " + options_.unix_path);
+    	}
+    } else {
+    	sockaddr_in address{};
+    	address.sin_family = AF_INET;
+    	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    	address.sin_port = htons(options_.tcp_port);
+    	listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    	if (listen_fd_ < 0) {
+    		throw MakeSystemError("socket");
+    	}
+    	const int enable = 1;
+    	setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    	if (bind(listen_fd_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0) {
+    		throw MakeSystemError("bind 127.0.0.1:" + std::to_string(options_.tcp_port));
+    	}
+    	socklen_t length = sizeof(address);
+    	getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&address), &length);
+    	tcp_port_ = ntohs(address.sin_port);
+    }
+    if (listen(listen_fd_, SOMAXCONN) < 0) {
+    	throw MakeSystemError("listen");
+    }
+
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = LISTEN_ID;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_fd_, &event) < 0) {
+    	throw MakeSystemError("epoll_ctl");
+    }
+    event.data.u64 = STOP_ID;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, stop_fd_, &event) < 0) {
+    	throw MakeSystemError("epoll_ctl");
+    }
+}
+
+void SearchDaemon::Run() {
+    epoll_event events[MAX_EVENTS];
+    bool stopping = false;
+    while (!stopping) {
+    	const int count = epoll_wait(epoll_fd_, events, MAX_EVENTS, -1);
+    	if (count < 0) {
+    		if (errno == EINTR) {
+    			continue;
+    		}
+    		throw MakeSystemError("epoll_wait");
+    	}
+    	for (int i = 0; i < count; ++i) {
+    		const uint64_t id = events[i].data.u64;
+    		if (id == LISTEN_ID) {
+    			AcceptConnections();
+    		} else if (id == STOP_ID) {
+    			stopping = true;
+    		} else if (id == DURABLE_ID) {
+    			try {
+    				durable_lsn_ = index_log_->PollDurable();
+    			} catch (const std::system_error& e) {
+    				FailIndexLog(e);
+    			}
+    			ReleaseParked();
+    		} else if (connections_.count(id) > 0) {
+    			// a hangup after end of stream leaves no one to answer, and it would be reported on every wait
+    			if ((events[i].events & EPOLLERR)
+    					|| ((events[i].events & EPOLLHUP) && connections_.at(id).closing)) {
+    				CloseConnection(id);
+    				continue;
+    			}
+    			if (events[i].events & EPOLLOUT) {
+    				FlushConnection(id);
+    			}
+    			// after a hangup read still returns the remaining requests before end of stream
+    			if ((events[i].events & (EPOLLIN | EPOLLHUP)) && connections_.count(id) > 0) {
+    				ReadConnection(id);
+    			}
+    		}
+    	}
+
+    	for (size_t begin = 0; begin < pending_.size(); begin += options_.max_batch_size) {
+    		std::vector<PendingRequest> batch(
+    				std::make_move_iterator(pending_.begin() + begin),
+    				std::make_move_iterator(pending_.begin() + std::min(pending_.size(), begin + options_.max_batch_size)));
+    		ExecuteBatch(batch);
+    	}
+    	pending_.clear();
+    	std::sort(touched_.begin(), touched_.end());
+    	touched_.erase(std::unique(touched_.begin(), touched_.end()), touched_.end());
+    	for (const uint64_t id : touched_) {
+    		if (connections_.count(id) > 0) {
+    			FlushConnection(id);
+    		}
+    	}
+    	touched_.clear();
+    }
+}
+
+void SearchDaemon::Stop() {
+    const uint64_t value = 1;
+    [[maybe_unused]] const ssize_t written = write(stop_fd_, &value, sizeof(value));
+}
+
+uint16_t SearchDaemon::GetTcpPort() const {
+    return tcp_port_;
+}
+
+SearchDaemonStats SearchDaemon::GetStats() const {
+    return stats_;
+}
+
+void SearchDaemon::AcceptConnections() {
+    while (true) {
+    	const int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    	if (fd < 0) {
+    		if (errno == EINTR) {
+    			continue;
+    		}
+    		// EAGAIN once the backlog is empty; other errors only affect the connection being accepted
+    		return;
+    	}
+    	if (options_.unix_path.empty()) {
+    		const int enable = 1;
+    		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+    	}
+    	const uint64_t id = next_connection_id_++;
+    	epoll_event event{};
+    	event.events = EPOLLIN;
+    	event.data.u64 = id;
+    	if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) < 0) {
+    		close(fd);
+    		continue;
+    	}
+    	connections_[id].fd = fd;
+    	++stats_.connections_accepted;
+    }
+}
+
+void SearchDaemon::ReadConnection(uint64_t connection_id) {
+    Connection& connection = connections_.at(connection_id);
+    // epoll is level-triggered, so bytes left in the socket wake the next iteration up again
+    size_t bytes_left = options_.max_read_per_wakeup;
+    while (bytes_left > 0) {
+    	const size_t size = connection.input.size();
+    	const size_t chunk_size = std::min(READ_CHUNK_SIZE, bytes_left);
+    	connection.input.resize(size + chunk_size);
+    	const ssize_t bytes_read = read(connection.fd, connection.input.data() + size, chunk_size);
+    	connection.input.resize(size + std::max<ssize_t>(bytes_read, 0));
+    	if (bytes_read > 0) {
+    		bytes_left -= bytes_read;
+    		continue;
+    	}
+    	if (bytes_read == 0) {
+    		connection.closing = true;
+    		break;
+    	}
+    	if (errno == EINTR) {
+    		continue;
+    	}
+    	if (errno == EAGAIN || errno == EWOULDBLOCK) {
+    		break;
+    	}
+    	pending_.erase(std::remove_if(pending_.begin(), pending_.end(), [connection_id](const PendingRequest& pending) {
+    		return pending.connection_id == connection_id;
+    	}), pending_.end());
+    	CloseConnection(connection_id);
+    	return;
+    }
+
+    std::string_view input = connection.input;
+    size_t frame_count = 0;
+    try {
+    	while (const size_t frame_size = GetFrameSize(input)) {
+    		pending_.push_back({connection_id, DecodeRequest(input.substr(0, frame_size))});
+    		input.remove_prefix(frame_size);
+    		++frame_count;
+    	}
+    } catch (const std::runtime_error&) {
+    	// the stream cannot be resynchronized after a malformed frame, requests before it are still answered
+    	++stats_.protocol_errors;
+    	connection.closing = true;
+    	input = {};
+    }
+    connection.input.erase(0, connection.input.size() - input.size());
+    connection.unanswered += frame_count;
+
+    if (connection.closing && frame_count == 0) {
+    	FlushConnection(connection_id);
+    } else {
+    	UpdateEvents(connection_id);
+    }
+}
+
+void SearchDaemon::FlushConnection(uint64_t connection_id) {
+    Connection& connection = connections_.at(connection_id);
+    while (connection.output_offset < connection.output.size()) {
+    	const ssize_t written = send(connection.fd, connection.output.data() + connection.output_offset,
+    			connection.output.size() - connection.output_offset, MSG_NOSIGNAL);
+    	if (written < 0) {
+    		if (errno == EINTR) {
+    			continue;
+    		}
+    		if (errno == EAGAIN || errno == EWOULDBLOCK) {
+    			break;
+    		}
+    		CloseConnection(connection_id);
+    		return;
+    	}
+    	connection.output_offset += written;
+    }
+    if (connection.output_offset == connection.output.size()) {
+    	connection.output.clear();
+    	connection.output_offset = 0;
+    	if (connection.closing && connection.unanswered == 0) {
+    		CloseConnection(connection_id);
+    		return;
+    	}
+    }
+    UpdateEvents(connection_id);
+}
+
+void SearchDaemon::UpdateEvents(uint64_t connection_id) {
+    Connection& connection = connections_.at(connection_id);
+    const size_t pending_output = connection.output.size() - connection.output_offset;
+    const bool reading = !connection.closing && pending_output < options_.max_pending_output
+    		&& connection.unanswered < options_.max_unanswered_requests;
+    epoll_event event{};
+    event.events = (reading ? static_cast<uint32_t>(EPOLLIN) : 0u) | (pending_output > 0 ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+    event.data.u64 = connection_id;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, connection.fd, &event);
+}
+
+void SearchDaemon::CloseConnection(uint64_t connection_id) {
+    const auto it = connections_.find(connection_id);
+    if (it == connections_.end()) {
+    	return;
+    }
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, it->second.fd, nullptr);
+    close(it->second.fd);
+    connections_.erase(it);
+}
+
+void SearchDaemon::ExecuteBatch(std::vector<PendingRequest>& batch) {
+    std::vector<SearchResponse> responses(batch.size());
+    std::vector<uint64_t> record_lsns(batch.size(), 0);
+    // a response may reveal every mutation executed before it, so it waits for the last record appended so far
+    std::vector<uint64_t> wait_lsns(batch.size(), 0);
+    for (size_t begin = 0; begin < batch.size(); ) {
+    	if (batch[begin].request.IsMutation()) {
+    		responses[begin] = ExecuteMutation(batch[begin].request, record_lsns[begin]);
+    		appended_lsn_ = std::max(appended_lsn_, record_lsns[begin]);
+    		wait_lsns[begin] = appended_lsn_;
+    		++begin;
+    		continue;
+    	}
+    	const auto end = std::find_if(batch.begin() + begin, batch.end(), [](const PendingRequest& pending) {
+    		return pending.request.IsMutation();
+    	});
+    	std::transform(std::execution::par, batch.begin() + begin, end, responses.begin() + begin,
+    			[this](const PendingRequest& pending) {
+    		return ExecuteQuery(pending.request);
+    	});
+    	std::fill(wait_lsns.begin() + begin, wait_lsns.begin() + (end - batch.begin()), appended_lsn_);
+    	begin = end - batch.begin();
+    }
+    if (!index_log_error_.empty()) {
+    	// responses held before the failure go out first, then the records of this batch count as lost
+    	ReleaseParked();
+    	for (size_t i = 0; i < batch.size(); ++i) {
+    		if (record_lsns[i] > durable_lsn_ && responses[i].error.empty()) {
+    			responses[i].error = index_log_error_;
+    		}
+    	}
+    }
+
+    for (size_t i = 0; i < batch.size(); ++i) {
+    	if (index_log_error_.empty() && wait_lsns[i] > durable_lsn_) {
+    		parked_.emplace(wait_lsns[i], ParkedResponse{batch[i].connection_id, record_lsns[i], std::move(responses[i])});
+    	} else {
+    		SendResponse(batch[i].connection_id, responses[i]);
+    	}
+    }
+    stats_.requests_served += batch.size();
+    ++stats_.batches_executed;
+}
+
+SearchResponse SearchDaemon::ExecuteQuery(const SearchRequest& request) const {
+    SearchResponse response;
+    response.request_id = request.request_id;
+    response.opcode = request.opcode;
+    // runs inside a parallel algorithm, where an escaping exception would terminate the process
+    try {
+    	if (request.opcode == SearchOpcode::FIND_TOP_DOCUMENTS) {
+    		response.documents = search_server_.FindTopDocuments(std::execution::seq, request.text, request.status);
+    	} else {
+    		const auto [words, status] = search_server_.MatchDocument(std::execution::seq, request.text, request.document_id);
+    		response.words.assign(words.begin(), words.end());
+    		response.status = status;
+    	}
+    } catch (const std::exception& e) {
+    	response.error = e.what();
+    }
+    return response;
+}
+
+SearchResponse SearchDaemon::ExecuteMutation(const SearchRequest& request, uint64_t& record_lsn) {
+    SearchResponse response;
+    response.request_id = request.request_id;
+    response.opcode = request.opcode;
+    if (!index_log_error_.empty()) {
+    	response.error = index_log_error_;
+    	return response;
+    }
+    try {
+    	if (request.opcode == SearchOpcode::ADD_DOCUMENT) {
+    		search_server_.AddDocument(request.document_id, request.text, request.status, request.ratings);
+    		if (index_log_ != nullptr) {
+    			record_lsn = index_log_->AppendAdd(request.document_id, request.text, request.status, request.ratings);
+    		}
+    	} else {
+    		search_server_.RemoveDocument(request.document_id);
+    		if (index_log_ != nullptr) {
+    			record_lsn = index_log_->AppendRemove(request.document_id);
+    		}
+    	}
+    } catch (const std::invalid_argument& e) {
+    	response.error = e.what();
+    } catch (const std::system_error& e) {
+    	FailIndexLog(e);
+    	response.error = index_log_error_;
+    }
+    return response;
+}
+
+void SearchDaemon::SendResponse(uint64_t connection_id, const SearchResponse& response) {
+    const auto it = connections_.find(connection_id);
+    if (it == connections_.end()) {
+    	return;
+    }
+    AppendResponse(it->second.output, response);
+    --it->second.unanswered;
+    touched_.push_back(connection_id);
+}
+
+// Sends the held responses that became durable; after an index log error sends all of them,
+// failing the mutations whose records were not known to be durable
+void SearchDaemon::ReleaseParked() {
+    const bool failed = !index_log_error_.empty();
+    const auto end = failed ? parked_.end() : parked_.upper_bound(durable_lsn_);
+    for (auto it = parked_.begin(); it != end; ++it) {
+    	ParkedResponse& parked = it->second;
+    	if (failed && parked.record_lsn > durable_lsn_ && parked.response.error.empty()) {
+    		parked.response.error = index_log_error_;
+    	}
+    	SendResponse(parked.connection_id, parked.response);
+    }
+    parked_.erase(parked_.begin(), end);
+}
+
+// The failed mutation is already applied in memory but not durable, so no later mutation is accepted
+void SearchDaemon::FailIndexLog(const std::system_error& error) {
+    if (index_log_error_.empty()) {
+    	index_log_error_ = std::string("index log failed, mutations are rejected: ") + error.what();
+    }
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "index_log.h"
+#include "search_protocol.h"
+#include "search_server.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <system_error>
+#include <vector>
+
+struct SearchDaemonOptions {
+    // Unix socket path; loopback TCP on tcp_port when empty, port 0 picks a free one
+    std::string unix_path;
+    uint16_t tcp_port = 0;
+    // most requests executed as one batch
+    size_t max_batch_size = 1024;
+    // a connection is not read while this many response bytes wait to be sent
+    size_t max_pending_output = 8 << 20;
+    // most bytes read from one connection per wakeup, so one peer cannot hold up the others
+    size_t max_read_per_wakeup = 1 << 20;
+    // a connection is not read while this many of its requests wait for their responses
+    size_t max_unanswered_requests = 4096;
+};
+
+struct SearchDaemonStats {
+    size_t connections_accepted = 0;
+    size_t requests_served = 0;
+    size_t batches_executed = 0;
+    size_t protocol_errors = 0;
+};
+
+// Serves SearchServer over a socket from one epoll thread. Requests read in one wakeup form a batch:
+// consecutive queries run in parallel, mutations run one at a time between them in arrival order.
+// With an index log every response is held until the mutations executed before it are durable;
+// the loop keeps serving meanwhile and releases held responses when the log signals durability.
+// After an index log error mutations are answered with that error while queries are still served
+class SearchDaemon {
+public:
+    SearchDaemon(SearchServer& search_server, const SearchDaemonOptions& options, IndexLog* index_log = nullptr);
+
+    SearchDaemon(const SearchDaemon&) = delete;
+    SearchDaemon& operator=(const SearchDaemon&) = delete;
+
+    ~SearchDaemon();
+
+    // Serves until Stop is called
+    void Run();
+    // Safe to call from another thread or a signal handler
+    void Stop();
+
+    uint16_t GetTcpPort() const;
+    SearchDaemonStats GetStats() const;
+
+private:
+    struct Connection {
+        int fd = -1;
+        std::string input;
+        std::string output;
+        size_t output_offset = 0;
+        // requests read whose responses are not in output yet
+        size_t unanswered = 0;
+        // the peer finished sending: answer what was read, then close
+        bool closing = false;
+    };
+    struct PendingRequest {
+        uint64_t connection_id;
+        SearchRequest request;
+    };
+    struct ParkedResponse {
+        uint64_t connection_id;
+        // sequence number of the mutation's own log record, 0 when it appended none
+        uint64_t record_lsn;
+        SearchResponse response;
+    };
+
+    SearchServer& search_server_;
+    SearchDaemonOptions options_;
+    IndexLog* index_log_;
+    int listen_fd_ = -1;
+    int stop_fd_ = -1;
+    int epoll_fd_ = -1;
+    uint16_t tcp_port_ = 0;
+    uint64_t next_connection_id_ = 3;
+    std::map<uint64_t, Connection> connections_;
+    std::vector<PendingRequest> pending_;
+    // keyed by the sequence number that has to be durable first; equal keys keep execution order
+    std::multimap<uint64_t, ParkedResponse> parked_;
+    uint64_t appended_lsn_ = 0;
+    uint64_t durable_lsn_ = 0;
+    // connections given new output since the last flush
+    std::vector<uint64_t> touched_;
+    SearchDaemonStats stats_;
+    // set once the index log fails; every later mutation is answered with it
+    std::string index_log_error_;
+
+    void Listen();
+    void AcceptConnections();
+    void ReadConnection(uint64_t connection_id);
+    void FlushConnection(uint64_t connection_id);
+    void UpdateEvents(uint64_t connection_id);
+    void CloseConnection(uint64_t connection_id);
+    void ExecuteBatch(std::vector<PendingRequest>& batch);
+    SearchResponse ExecuteQuery(const SearchRequest& request) const;
+    SearchResponse ExecuteMutation(const SearchRequest& request, uint64_t& record_lsn);
+    void SendResponse(uint64_t connection_id, const SearchResponse& response);
+    void ReleaseParked();
+    void FailIndexLog(const std::system_error& error);
+};
@@ -0,0 +1,211 @@
+#include "search_protocol.h"
+
+#include "binary_codec.h"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+const char* const FRAME_TRUNCATED = "search frame is truncated";
+
+SearchOpcode GetOpcode(BinaryReader& reader) {
+    const uint8_t opcode = reader.Get<uint8_t>();
+    if (opcode < static_cast<uint8_t>(SearchOpcode::FIND_TOP_DOCUMENTS)
+    		|| opcode > static_cast<uint8_t>(SearchOpcode::REMOVE_DOCUMENT)) {
+    	throw std::runtime_error("unknown search opcode");
+    }
+    return static_cast<SearchOpcode>(opcode);
+}
+
+DocumentStatus GetStatus(BinaryReader& reader) {
+    const uint8_t status = reader.Get<uint8_t>();
+    if (status > static_cast<uint8_t>(DocumentStatus::REMOVED)) {
+    	throw std::runtime_error("unknown document status");
+    }
+    return static_cast<DocumentStatus>(status);
+}
+
+// Reserves the size field and fills it once the payload is written
+class FrameWriter {
+public:
+    explicit FrameWriter(std::string& out)
+    	: out_(out)
+    	, start_(out.size())
+    {
+    	Put(out_, uint32_t{0});
+    }
+
+    ~FrameWriter() {
+    	const uint32_t size = static_cast<uint32_t>(out_.size() - start_ - SEARCH_FRAME_HEADER_SIZE);
+    	std::memcpy(out_.data() + start_, &size, sizeof(size));
+    }
+
+private:
+    std::string& out_;
+    size_t start_;
+};
+
+BinaryReader OpenFrame(std::string_view frame) {
+    BinaryReader reader(frame, FRAME_TRUNCATED);
+    const uint32_t size = reader.Get<uint32_t>();
+    if (size != reader.Remaining()) {
+    	throw std::runtime_error("search frame size mismatch");
+    }
+    return reader;
+}
+
+void CheckConsumed(const BinaryReader& reader) {
+    if (reader.Remaining() != 0) {
+    	throw std::runtime_error("search frame has trailing bytes");
+    }
+}
+
+}
+
+bool SearchRequest::IsMutation() const {
+    return opcode == SearchOpcode::ADD_DOCUMENT || opcode == SearchOpcode::REMOVE_DOCUMENT;
+}
+
+void AppendRequest(std::string& out, const SearchRequest& request) {
+    FrameWriter frame(out);
+    Put(out, request.request_id);
+    Put(out, static_cast<uint8_t>(request.opcode));
+    switch (request.opcode) {
+    case SearchOpcode::FIND_TOP_DOCUMENTS:
+    	Put(out, static_cast<uint8_t>(request.status));
+    	PutBytes(out, request.text);
+    	break;
+    case SearchOpcode::MATCH_DOCUMENT:
+    	Put(out, static_cast<int32_t>(request.document_id));
+    	PutBytes(out, request.text);
+    	break;
+    case SearchOpcode::ADD_DOCUMENT:
+    	Put(out, static_cast<int32_t>(request.document_id));
+    	Put(out, static_cast<uint8_t>(request.status));
+    	Put(out, static_cast<uint32_t>(request.ratings.size()));
+    	for (const int rating : request.ratings) {
+    		Put(out, static_cast<int32_t>(rating));
+    	}
+    	PutBytes(out, request.text);
+    	break;
+    case SearchOpcode::REMOVE_DOCUMENT:
+    	Put(out, static_cast<int32_t>(request.document_id));
+    	break;
+    }
+}
+
+void AppendResponse(std::string& out, const SearchResponse& response) {
+    FrameWriter frame(out);
+    Put(out, response.request_id);
+    Put(out, static_cast<uint8_t>(response.opcode));
+    Put(out, static_cast<uint8_t>(response.error.empty() ? 0 : 1));
+    if (!response.error.empty()) {
+    	PutBytes(out, response.error);
+    	return;
+    }
+    switch (response.opcode) {
+    case SearchOpcode::FIND_TOP_DOCUMENTS:
+    	Put(out, static_cast<uint32_t>(response.documents.size()));
+    	for (const Document& document : response.documents) {
+    		Put(out, static_cast<int32_t>(document.id));
+    		Put(out, document.relevance);
+    		Put(out, static_cast<int32_t>(document.rating));
+    	}
+    	break;
+    case SearchOpcode::MATCH_DOCUMENT:
+    	Put(out, static_cast<uint8_t>(response.status));
+    	Put(out, static_cast<uint32_t>(response.words.size()));
+    	for (const std::string& word : response.words) {
+    		PutBytes(out, word);
+    	}
+    	break;
+    default:
+    	break;
+    }
+}
+
+size_t GetFrameSize(std::string_view buffer) {
+    if (buffer.size() < SEARCH_FRAME_HEADER_SIZE) {
+    	return 0;
+    }
+    uint32_t size;
+    std::memcpy(&size, buffer.data(), sizeof(size));
+    if (size > SEARCH_MAX_FRAME_SIZE) {
+    	throw std::runtime_error("search frame is too large");
+    }
+    const size_t frame_size = SEARCH_FRAME_HEADER_SIZE + size;
+    return buffer.size() < frame_size ? 0 : frame_size;
+}
+
+SearchRequest DecodeRequest(std::string_view frame) {
+    BinaryReader reader = OpenFrame(frame);
+    SearchRequest request;
+    request.request_id = reader.Get<uint32_t>();
+    request.opcode = GetOpcode(reader);
+    switch (request.opcode) {
+    case SearchOpcode::FIND_TOP_DOCUMENTS:
+    	request.status = GetStatus(reader);
+    	request.text = reader.GetBytes();
+    	break;
+    case SearchOpcode::MATCH_DOCUMENT:
+    	request.document_id = reader.Get<int32_t>();
+    	request.text = reader.GetBytes();
+    	break;
+    case SearchOpcode::ADD_DOCUMENT: {
+    	request.document_id = reader.Get<int32_t>();
+    	request.status = GetStatus(reader);
+    	const uint32_t rating_count = reader.Get<uint32_t>();
+    	if (rating_count > reader.Remaining() / sizeof(int32_t)) {
+    		throw std::runtime_error("search frame is truncated");
+    	}
+    	request.ratings.reserve(rating_count);
+    	for (uint32_t i = 0; i < rating_count; ++i) {
+    		request.ratings.push_back(reader.Get<int32_t>());
+    	}
+    	request.text = reader.GetBytes();
+    	break;
+    }
+    case SearchOpcode::REMOVE_DOCUMENT:
+    	request.document_id = reader.Get<int32_t>();
+    	break;
+    }
+    CheckConsumed(reader);
+    return request;
+}
+
+SearchResponse DecodeResponse(std::string_view frame) {
+    BinaryReader reader = OpenFrame(frame);
+    SearchResponse response;
+    response.request_id = reader.Get<uint32_t>();
+    response.opcode = GetOpcode(reader);
+    if (reader.Get<uint8_t>() != 0) {
+    	response.error = reader.GetBytes();
+    	CheckConsumed(reader);
+    	return response;
+    }
+    switch (response.opcode) {
+    case SearchOpcode::FIND_TOP_DOCUMENTS: {
+    	const uint32_t count = reader.Get<uint32_t>();
+    	for (uint32_t i = 0; i < count; ++i) {
+    		const int id = reader.Get<int32_t>();
+    		const double relevance = reader.Get<double>();
+    		const int rating = reader.Get<int32_t>();
+    		response.documents.push_back({id, relevance, rating});
+    	}
+    	break;
+    }
+    case SearchOpcode::MATCH_DOCUMENT: {
+    	response.status = GetStatus(reader);
+    	const uint32_t count = reader.Get<uint32_t>();
+    	for (uint32_t i = 0; i < count; ++i) {
+    		response.words.emplace_back(reader.GetBytes());
+    	}
+    	break;
+    }
+    default:
+    	break;
+    }
+    CheckConsumed(reader);
+    return response;
+}
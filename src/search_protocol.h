@@ -0,0 +1,56 @@
+#pragma once
+
+#include "document.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Frames are a uint32 payload size followed by the payload, integers in host byte order,
+// so both ends must run on the same architecture, which holds for Unix sockets and loopback TCP.
+// Requests on one connection are answered in order, so clients may pipeline them.
+enum class SearchOpcode : uint8_t {
+    FIND_TOP_DOCUMENTS = 1,
+    MATCH_DOCUMENT = 2,
+    ADD_DOCUMENT = 3,
+    REMOVE_DOCUMENT = 4,
+};
+
+const size_t SEARCH_FRAME_HEADER_SIZE = sizeof(uint32_t);
+const size_t SEARCH_MAX_FRAME_SIZE = 16 << 20;
+
+struct SearchRequest {
+    uint32_t request_id = 0;
+    SearchOpcode opcode = SearchOpcode::FIND_TOP_DOCUMENTS;
+    int document_id = 0;
+    // filter of FIND_TOP_DOCUMENTS, status of ADD_DOCUMENT
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    // query of FIND_TOP_DOCUMENTS and MATCH_DOCUMENT, text of ADD_DOCUMENT
+    std::string text;
+    std::vector<int> ratings;
+
+    bool IsMutation() const;
+};
+
+struct SearchResponse {
+    uint32_t request_id = 0;
+    SearchOpcode opcode = SearchOpcode::FIND_TOP_DOCUMENTS;
+    // empty on success
+    std::string error;
+    std::vector<Document> documents;
+    std::vector<std::string> words;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+};
+
+void AppendRequest(std::string& out, const SearchRequest& request);
+void AppendResponse(std::string& out, const SearchResponse& response);
+
+// Size of the complete frame at the start of buffer including its header, 0 if more bytes are needed;
+// throws std::runtime_error if the announced size exceeds SEARCH_MAX_FRAME_SIZE
+size_t GetFrameSize(std::string_view buffer);
+
+// Take one complete frame including its header; throw std::runtime_error on malformed payloads
+SearchRequest DecodeRequest(std::string_view frame);
+SearchResponse DecodeResponse(std::string_view frame);
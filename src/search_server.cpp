@@ -7,14 +7,31 @@
 #include <cmath>
 #include <algorithm>
 #include <string_view>
+#include <thread>
 
-SearchServer::SearchServer(const std::string_view& stop_words_text)
-    : SearchServer(SplitIntoWords(stop_words_text))  // Invoke delegating constructor from string container
+SearchServer::SearchServer(std::shared_ptr<SearchContext> context)
+    : context_(RequireContext(std::move(context)))
 {
 }
 
-SearchServer::SearchServer(const std::string& stop_words_text)
-    : SearchServer(SplitIntoWords(stop_words_text))  // Invoke delegating constructor from string container
+SearchServer::~SearchServer() {
+    // a moved-from server has no context and no documents
+    if (context_) {
+    	for (const auto& [_, entry] : forward_index_) {
+    		for (const int term_id : entry.term_ids) {
+    			context_->GetTerms().Release(term_id);
+    		}
+    	}
+    }
+}
+
+SearchServer::SearchServer(const std::string_view& stop_words_text, std::pmr::memory_resource* upstream)
+    : SearchServer(SplitIntoWords(stop_words_text), upstream)  // Invoke delegating constructor from string container
+{
+}
+
+SearchServer::SearchServer(const std::string& stop_words_text, std::pmr::memory_resource* upstream)
+    : SearchServer(SplitIntoWords(stop_words_text), upstream)  // Invoke delegating constructor from string container
 {
 }
 
@@ -22,23 +39,51 @@ void SearchServer::AddDocument(int document_id, const std::string_view& document
     if ((document_id < 0) || (documents_.count(document_id) > 0)) {
     	throw std::invalid_argument("document id is negative or already exists");
     }
-    const std::vector<std::string> words = SplitIntoWordsNoStop(document);
+    const std::vector<std::string_view> words = SplitIntoWordsNoStop(document);
+    if (!std::all_of(words.begin(), words.end(), IsValidWord)) {
+    	throw std::invalid_argument("Word has illegal characters");
+    }
 
-    for (const std::string& word : words) {
-    	if (IsValidWord(word)){
-        	word_to_document_freqs_[word][document_id] += 1.0 / words.size();
-            document_to_word_freqs_[document_id][word] += 1.0 / words.size();
-    	}else{
-    		RemoveDocument(document_id);
+    // the document holds one dictionary reference per distinct word
+    std::vector<std::string_view> sorted_words = words;
+    std::sort(sorted_words.begin(), sorted_words.end());
+    std::vector<std::pair<TermDictionary::Term, double>> term_freqs;
+    for (auto it = sorted_words.begin(); it != sorted_words.end(); ) {
+    	double term_freq = 0.0;
+    	const std::string_view word = *it;
+    	for (; it != sorted_words.end() && *it == word; ++it) {
+    		term_freq += 1.0 / words.size();
+    	}
+    	term_freqs.push_back({context_->GetTerms().Intern(word), term_freq});
+    }
+    IndexTerms(document_id, term_freqs);
+    documents_.emplace(document_id, DocumentData{ComputeAverageRating(ratings), status, AcquireSlot(document_id)});
+    document_ids_.insert(document_id);
+}
+
+void SearchServer::RestoreDocument(int document_id, DocumentStatus status, int rating,
+		const std::map<std::string_view, double>& word_freqs) {
+    if ((document_id < 0) || (documents_.count(document_id) > 0)) {
+    	throw std::invalid_argument("document id is negative or already exists");
+    }
+    for (const auto& [word, _] : word_freqs) {
+    	if (word.empty() || !IsValidWord(word) || IsStopWord(word)) {
     		throw std::invalid_argument("Word has illegal characters");
     	}
     }
-    documents_.emplace(document_id, DocumentData{ComputeAverageRating(ratings), status});
+
+    std::vector<std::pair<TermDictionary::Term, double>> term_freqs;
+    term_freqs.reserve(word_freqs.size());
+    for (const auto& [word, term_freq] : word_freqs) {
+    	term_freqs.push_back({context_->GetTerms().Intern(word), term_freq});
+    }
+    IndexTerms(document_id, term_freqs);
+    documents_.emplace(document_id, DocumentData{rating, status, AcquireSlot(document_id)});
     document_ids_.insert(document_id);
 }
 
 std::vector<Document> SearchServer::FindTopDocuments(const std::string_view& raw_query, DocumentStatus status) const {
-    return FindTopDocuments(raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
+    return FindTopDocuments(raw_query, [status](int, DocumentStatus document_status, int) {
     	return document_status == status;
     });
 }
@@ -47,28 +92,50 @@ std::vector<Document> SearchServer::FindTopDocuments(const std::string_view& raw
     return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
 }
 
+size_t SearchServer::FindTopDocumentsInto(const std::string_view& raw_query, std::span<Document> out) const {
+    const Query query = ParseQuery(raw_query);
+    const size_t top_count = std::min<size_t>(out.size(), MAX_RESULT_DOCUMENT_COUNT);
+    const std::vector<Document> candidates = FindAllDocuments(std::execution::seq, query,
+    		[](int, DocumentStatus status, int) {
+    	return status == DocumentStatus::ACTUAL;
+    }, top_count);
+    return std::partial_sort_copy(candidates.begin(), candidates.end(), out.begin(), out.begin() + top_count, IsRankedBefore)
+    		- out.begin();
+}
+
+std::vector<Document> SearchServer::FindTopDocumentsAfter(const std::string_view& raw_query, const Document& last, size_t limit) const {
+    return FindTopDocumentsAfter(raw_query, [](int, DocumentStatus document_status, int) {
+    	return document_status == DocumentStatus::ACTUAL;
+    }, last, limit);
+}
+
 int SearchServer::GetDocumentCount() const {
     return documents_.size();
 }
 
-std::set<int>::const_iterator SearchServer::begin() const {
+std::pmr::set<int>::const_iterator SearchServer::begin() const {
     return document_ids_.begin();
 }
 
-std::set<int>::const_iterator SearchServer::end() const {
+std::pmr::set<int>::const_iterator SearchServer::end() const {
     return document_ids_.end();
 }
 
-std::map<std::string_view, double> word_freqs_;
-const std::map<std::string_view, double>& SearchServer::GetWordFrequencies(int document_id) const {
-	word_freqs_.clear();
-	if (document_to_word_freqs_.count(document_id) == 1){
-		for (const auto& el : document_to_word_freqs_.at(document_id)){;
-			const std::string_view el_first_sv = el.first;
-			word_freqs_.emplace(el_first_sv, el.second);
-		}
+DocumentTerms SearchServer::GetWordFrequencies(int document_id) const {
+	const auto it = forward_index_.find(document_id);
+	if (it == forward_index_.end()) {
+		return {};
 	}
-	return word_freqs_;
+	const ForwardIndexEntry& entry = it->second;
+	return {entry.term_ids, entry.words, entry.term_freqs};
+}
+
+DocumentStatus SearchServer::GetDocumentStatus(int document_id) const {
+	return documents_.at(document_id).status;
+}
+
+int SearchServer::GetDocumentRating(int document_id) const {
+	return documents_.at(document_id).rating;
 }
 
 void SearchServer::RemoveDocument(int document_id){
@@ -78,55 +145,61 @@ void SearchServer::RemoveDocument(int document_id){
 void SearchServer::RemoveDocument(const std::execution::sequenced_policy& policy, int document_id){
     if (document_ids_.count(document_id) != 0){
         document_ids_.erase(document_id);
+        ReleaseSlot(documents_.at(document_id).slot);
         documents_.erase(document_id);
 
-        const auto word_to_freqs = document_to_word_freqs_.at(document_id);
+        const auto& words = forward_index_.at(document_id).words;
         std::for_each(
             policy,
-			word_to_freqs.begin(),
-			word_to_freqs.end(),
-            [this, document_id](const auto& p)
-            {word_to_document_freqs_.at(p.first).erase(document_id);}
+			words.begin(),
+			words.end(),
+            [this, document_id](const std::string_view& word)
+            {word_to_document_freqs_.at(word).erase(document_id);}
         );
 
-        document_to_word_freqs_.erase(document_id);
+        ReleaseTerms(forward_index_.at(document_id));
+        forward_index_.erase(document_id);
     }
 }
 
 void SearchServer::RemoveDocument(const std::execution::parallel_policy& policy, int document_id){
     if (document_ids_.count(document_id) != 0){
         document_ids_.erase(document_id);
+        ReleaseSlot(documents_.at(document_id).slot);
         documents_.erase(document_id);
 
-        const auto word_to_freqs = document_to_word_freqs_.at(document_id);
+        const auto& words = forward_index_.at(document_id).words;
         std::for_each(
             policy,
-			word_to_freqs.begin(),
-			word_to_freqs.end(),
-            [this, document_id](const auto& p)
-            {word_to_document_freqs_.at(p.first).erase(document_id);}
+			words.begin(),
+			words.end(),
+            [this, document_id](const std::string_view& word)
+            {word_to_document_freqs_.at(word).erase(document_id);}
         );
 
-        document_to_word_freqs_.erase(document_id);
+        ReleaseTerms(forward_index_.at(document_id));
+        forward_index_.erase(document_id);
     }
 }
 
-std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(const std::execution::sequenced_policy& policy ,const std::string_view& raw_query, int document_id) const {
+std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(const std::execution::sequenced_policy&, const std::string_view& raw_query, int document_id) const {
 	const Query query = ParseQuery(raw_query);
     std::vector<std::string_view> matched_words;
     for (const std::string_view& word : query.plus_words) {
-    	if (word_to_document_freqs_.count({word.begin(), word.end()}) == 0) {
+    	const auto word_it = word_to_document_freqs_.find(word);
+    	if (word_it == word_to_document_freqs_.end()) {
     		continue;
     	}
-    	if (word_to_document_freqs_.at({word.begin(), word.end()}).count(document_id)) {
+    	if (word_it->second.count(document_id)) {
     	    matched_words.push_back(word);
     	}
     }
     for (const std::string_view& word : query.minus_words) {
-    	if (word_to_document_freqs_.count({word.begin(), word.end()}) == 0) {
+    	const auto word_it = word_to_document_freqs_.find(word);
+    	if (word_it == word_to_document_freqs_.end()) {
     		continue;
     	}
-    	if (word_to_document_freqs_.at({word.begin(), word.end()}).count(document_id)) {
+    	if (word_it->second.count(document_id)) {
     	    matched_words.clear();
     	    break;
     	}
@@ -137,54 +210,61 @@ std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDoc
 
 std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(const std::execution::parallel_policy& policy ,const std::string_view& raw_query, int document_id) const {
 	const Query query = ParseQuery(raw_query);
-    std::vector<std::string_view> matched_words;
-    std::mutex mutex_;
-
-	std::for_each(
-			std::execution::par,
-			query.plus_words.begin(), query.plus_words.end(),
-					[&](const std::string_view& word){
-    	if (word_to_document_freqs_.at({word.begin(), word.end()}).count(document_id)) {
-    		std::lock_guard guard(mutex_);
-    	    matched_words.push_back(word);
-    	}
-	});
-
-	std::for_each(
-			std::execution::par,
-			query.minus_words.begin(), query.minus_words.end(),
-					[&](const std::string_view& word){
-    	if (word_to_document_freqs_.at({word.begin(), word.end()}).count(document_id)) {
-    		std::lock_guard guard(mutex_);
-    	    matched_words.clear();
-    	}
-	});
+	const DocumentStatus status = documents_.at(document_id).status;
+	const auto is_in_document = [this, document_id](const std::string_view& word) {
+		const auto it = word_to_document_freqs_.find(word);
+		return it != word_to_document_freqs_.end() && it->second.count(document_id) > 0;
+	};
+
+	if (std::any_of(policy, query.minus_words.begin(), query.minus_words.end(), is_in_document)) {
+		return {std::vector<std::string_view>{}, status};
+	}
+    std::vector<std::string_view> matched_words(query.plus_words.size());
+    const auto words_end = std::copy_if(policy, query.plus_words.begin(), query.plus_words.end(),
+    		matched_words.begin(), is_in_document);
+    matched_words.erase(words_end, matched_words.end());
 
-    return {matched_words, documents_.at(document_id).status};
+    return {matched_words, status};
 }
 
 std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(const std::string_view& raw_query, int document_id) const {
 	return MatchDocument(std::execution::seq, raw_query, document_id);
 }
 
-bool SearchServer::IsStopWord(const std::string_view& word) const {
-    return stop_words_.count(word) > 0;
+MatchedDocuments SearchServer::MatchDocuments(const std::string_view& raw_query, const std::vector<int>& document_ids) const {
+	return MatchDocuments(std::execution::seq, raw_query, document_ids);
 }
 
-bool SearchServer::IsValidWord(const std::string_view& word) {
-    return std::none_of(word.begin(), word.end(), [](char c) {
-        return c >= '\0' && c < ' ';
-    });
+QueryPlan SearchServer::ExplainQuery(const std::execution::sequenced_policy&, const std::string_view& raw_query) const {
+	return PlanQuery(ParseQuery(raw_query), false).plan;
 }
 
-std::vector<std::string> SearchServer::SplitIntoWordsNoStop(const std::string_view& text) const {
-    std::vector<std::string> words;
-    for (const std::string& word : SplitIntoWords(text)){
-    	if (!IsStopWord(word)) {
-    		words.push_back(word);
-    	}
-    }
-    return words;
+QueryPlan SearchServer::ExplainQuery(const std::execution::parallel_policy&, const std::string_view& raw_query) const {
+	return PlanQuery(ParseQuery(raw_query), true).plan;
+}
+
+QueryPlan SearchServer::ExplainQuery(const std::string_view& raw_query) const {
+	return ExplainQuery(std::execution::seq, raw_query);
+}
+
+MemoryStats SearchServer::GetIndexMemoryStats() const {
+	return context_->GetIndexMemoryStats();
+}
+
+MemoryStats SearchServer::GetReservedMemoryStats() const {
+	return context_->GetReservedMemoryStats();
+}
+
+const std::shared_ptr<SearchContext>& SearchServer::GetContext() const {
+	return context_;
+}
+
+bool SearchServer::IsStopWord(const std::string_view& word) const {
+    return context_->IsStopWord(word);
+}
+
+std::vector<std::string_view> SearchServer::SplitIntoWordsNoStop(const std::string_view& text) const {
+    return context_->SplitIntoWordsNoStop(text);
 }
 
 int SearchServer::ComputeAverageRating(const std::vector<int>& ratings) {
@@ -198,38 +278,134 @@ int SearchServer::ComputeAverageRating(const std::vector<int>& ratings) {
     return rating_sum / static_cast<int>(ratings.size());
 }
 
-SearchServer::QueryWord SearchServer::ParseQueryWord(std::string_view text) const {
-    bool is_minus = false;
-    if (text[0] == '-') {
-    	is_minus = true;
-    	text = text.substr(1);
+SearchServer::Query SearchServer::ParseQuery(const std::string_view& text) const {
+    return context_->ParseQuery(text);
+}
+
+std::vector<SearchServer::TermRef> SearchServer::ResolveTerms(const std::set<std::string_view>& words) const {
+    std::vector<TermRef> terms;
+    for (const std::string_view& word : words) {
+    	if (const auto term = context_->GetTerms().Find(word)) {
+    		terms.push_back({term->id, term->data});
+    	}
     }
-    if (text.empty() || text[0] == '-'){
-    	throw std::invalid_argument("Wrong value of minus word");
+    return terms;
+}
+
+SearchServer::PlannedQuery SearchServer::PlanQuery(const Query& query, bool allow_parallel) const {
+    PlannedQuery planned;
+    QueryPlan& plan = planned.plan;
+
+    std::vector<std::pair<QueryPlan::Term, const Postings*>> plus_terms;
+    for (const std::string_view& word : query.plus_words) {
+    	const auto word_it = word_to_document_freqs_.find(word);
+    	if (word_it == word_to_document_freqs_.end() || word_it->second.empty()) {
+    		plan.absent_words.push_back(word);
+    		continue;
+    	}
+    	plus_terms.push_back({{word, word_it->second.size(), ComputeWordInverseDocumentFreq(word)}, &word_it->second});
+    }
+    std::stable_sort(plus_terms.begin(), plus_terms.end(), [](const auto& lhs, const auto& rhs) {
+    	return lhs.first.document_count < rhs.first.document_count;
+    });
+    for (const auto& [term, postings] : plus_terms) {
+    	plan.plus_terms.push_back(term);
+    	planned.plus_postings.push_back(postings);
+    	plan.estimated_postings += term.document_count;
     }
-    return { text, is_minus, IsStopWord(text) };
+
+    std::vector<int> excluded_ids;
+    for (const std::string_view& word : query.minus_words) {
+    	const auto word_it = word_to_document_freqs_.find(word);
+    	if (word_it == word_to_document_freqs_.end() || word_it->second.empty()) {
+    		plan.absent_words.push_back(word);
+    		continue;
+    	}
+    	plan.minus_terms.push_back({word, word_it->second.size(), 0.0});
+    	for (const auto& [document_id, _] : word_it->second) {
+    		excluded_ids.push_back(document_id);
+    	}
+    }
+    if (!plan.plus_terms.empty() && !excluded_ids.empty()) {
+    	planned.excluded.Assign(std::move(excluded_ids), *document_ids_.rbegin());
+    }
+    plan.excluded_documents = planned.excluded.size();
+
+    if (allow_parallel && plan.estimated_postings >= PARALLEL_QUERY_MIN_POSTINGS) {
+    	// queries of all servers on the context share one budget, the rest run sequentially
+    	planned.parallel_permit = context_->TryAcquireParallel();
+    }
+    if (!planned.parallel_permit) {
+    	plan.execution = QueryExecution::SEQUENTIAL;
+    	plan.dense_scores = plan.estimated_postings > 0
+    			&& plan.estimated_postings * DENSE_SCORES_MAX_SLOTS_PER_POSTING >= slot_to_document_id_.size();
+    } else if (plan.plus_terms.back().document_count * 2 > plan.estimated_postings) {
+    	// one term dominates the work, so splitting by term would leave other threads idle
+    	plan.execution = QueryExecution::SHARDED;
+    	plan.shard_count = std::max(2u, std::thread::hardware_concurrency());
+    } else {
+    	plan.execution = QueryExecution::PARALLEL;
+    }
+    return planned;
 }
 
-SearchServer::Query SearchServer::ParseQuery(const std::string_view& text) const {
-    Query query;
-    for (const std::string_view& word : SplitIntoWordsView(text)){
-    	if (IsValidWord(word)){
-    		const QueryWord query_word = ParseQueryWord(word);
-    		if (query_word.is_stop){
-    			continue;
-    		}
-    		if (query_word.is_minus){
-    			query.minus_words.insert(query_word.data);
-    		}else{
-    			query.plus_words.insert(query_word.data);
-    		}
-    	}else{
-    		throw std::invalid_argument("Word has illegal characters");
+uint32_t SearchServer::AcquireSlot(int document_id) {
+    if (free_slots_.empty()) {
+    	slot_to_document_id_.push_back(document_id);
+    	return static_cast<uint32_t>(slot_to_document_id_.size() - 1);
+    }
+    const uint32_t slot = free_slots_.back();
+    free_slots_.pop_back();
+    slot_to_document_id_[slot] = document_id;
+    return slot;
+}
+
+void SearchServer::ReleaseSlot(uint32_t slot) {
+    slot_to_document_id_[slot] = -1;
+    free_slots_.push_back(slot);
+}
+
+// Drops emptied posting lists before their words can be freed with the last dictionary reference
+void SearchServer::ReleaseTerms(const ForwardIndexEntry& entry) {
+    for (size_t i = 0; i < entry.term_ids.size(); ++i) {
+    	if (const auto it = word_to_document_freqs_.find(entry.words[i]); it->second.empty()) {
+    		word_to_document_freqs_.erase(it);
     	}
+    	context_->GetTerms().Release(entry.term_ids[i]);
     }
-    return query;
 }
 
-double SearchServer::ComputeWordInverseDocumentFreq(const std::string& word) const {
-    return std::log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
+void SearchServer::IndexTerms(int document_id, std::vector<std::pair<TermDictionary::Term, double>>& term_freqs) {
+    std::sort(term_freqs.begin(), term_freqs.end(), [](const auto& lhs, const auto& rhs) {
+    	return lhs.first.id < rhs.first.id;
+    });
+    ForwardIndexEntry& entry = forward_index_.try_emplace(document_id).first->second;
+    entry.term_ids.reserve(term_freqs.size());
+    entry.words.reserve(term_freqs.size());
+    entry.term_freqs.reserve(term_freqs.size());
+    for (const auto& [term, term_freq] : term_freqs) {
+    	word_to_document_freqs_[term.data][document_id] = term_freq;
+    	entry.term_ids.push_back(term.id);
+    	entry.words.push_back(term.data);
+    	entry.term_freqs.push_back(term_freq);
+    }
+}
+
+double SearchServer::ComputeWordInverseDocumentFreq(const std::string_view& word) const {
+    return std::log(GetDocumentCount() * 1.0 / word_to_document_freqs_.find(word)->second.size());
+}
+
+void SearchServer::SelectPage(std::vector<Document>& documents, size_t offset, size_t limit,
+		bool (*is_ranked_before)(const Document&, const Document&)) {
+    if (offset >= documents.size()) {
+        documents.clear();
+        return;
+    }
+    const size_t page_end = offset + std::min(limit, documents.size() - offset);
+    if (offset > 0) {
+        std::nth_element(documents.begin(), documents.begin() + offset, documents.end(), is_ranked_before);
+    }
+    std::partial_sort(documents.begin() + offset, documents.begin() + page_end, documents.end(), is_ranked_before);
+    documents.erase(documents.begin() + page_end, documents.end());
+    documents.erase(documents.begin(), documents.begin() + offset);
 }
@@ -3,36 +3,58 @@
 #include "string_processing.h"
 #include "document.h"
 #include "concurrent_map.h"
+#include "counting_memory_resource.h"
+#include "search_context.h"
+#include "query_plan.h"
+#include "scoring_kernels.h"
 
 #include <algorithm>
 #include <cmath>
+#include <cstdint>
+#include <limits>
 #include <map>
+#include <memory>
+#include <memory_resource>
 #include <set>
 #include <vector>
 #include <string>
 #include <stdexcept>
 #include <string_view>
 #include <execution>
+#include <numeric>
+#include <span>
 #include <utility>
 
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
+const size_t PARALLEL_QUERY_MIN_POSTINGS = 4096;
+const size_t DENSE_SCORES_MAX_SLOTS_PER_POSTING = 16;
+// Ranked before every document, the last document to pass for the first FindTopDocumentsAfter page
+inline const Document FIRST_PAGE_CURSOR(-1, std::numeric_limits<double>::infinity(), std::numeric_limits<int>::max());
 
 class SearchServer {
 public:
+    // Index containers allocate from a pool of a private context which takes memory from upstream
     template <typename StringContainer>
-    explicit SearchServer(const StringContainer& stop_words)
-    : stop_words_(MakeUniqueNonEmptyStrings(stop_words))
+    explicit SearchServer(const StringContainer& stop_words,
+    		std::pmr::memory_resource* upstream = std::pmr::new_delete_resource())
+    : SearchServer(std::make_shared<SearchContext>(stop_words, upstream))
     {
-        for (const auto& stop_word : stop_words_){
-            if (!IsValidWord(stop_word)){
-                throw std::invalid_argument("stop words are invalid");
-            }
-        }
     }
 
-    explicit SearchServer(const std::string_view& stop_words_text);
+    // Shares stop words, terms, memory pool and parallel query budget with other servers on the context
+    explicit SearchServer(std::shared_ptr<SearchContext> context);
+
+    explicit SearchServer(const std::string_view& stop_words_text,
+    		std::pmr::memory_resource* upstream = std::pmr::new_delete_resource());
+
+    explicit SearchServer(const std::string& stop_words_text,
+    		std::pmr::memory_resource* upstream = std::pmr::new_delete_resource());
 
-    explicit SearchServer(const std::string& stop_words_text);
+    SearchServer(const SearchServer&) = delete;
+    SearchServer& operator=(const SearchServer&) = delete;
+    SearchServer(SearchServer&&) = default;
+    // Releases the dictionary references of its documents
+    ~SearchServer();
 
     void AddDocument(int document_id, const std::string_view& document, DocumentStatus status, const std::vector<int>& ratings);
 
@@ -42,28 +64,63 @@ public:
     	std::vector<Document> matched_documents;
         const Query query = ParseQuery(raw_query);
 
-        matched_documents = FindAllDocuments(std::forward<ExecutionPolicy>(policy), query, document_predicate);
-        std::sort(matched_documents.begin(), matched_documents.end(), [](const Document& lhs, const Document& rhs) {
-            if (std::abs(lhs.relevance - rhs.relevance) < 1e-6) {
-                return lhs.rating > rhs.rating;
-            } else {
-                return lhs.relevance > rhs.relevance;
-            }
+        matched_documents = FindAllDocuments(std::forward<ExecutionPolicy>(policy), query, document_predicate,
+        		MAX_RESULT_DOCUMENT_COUNT);
+        SelectPage(matched_documents, 0, MAX_RESULT_DOCUMENT_COUNT);
+        return matched_documents;
+    }
+
+    // Returns documents [offset, offset + limit) of the full ranking. Pages follow IsRankedBeforeExact like cursor
+    // pages, so pages at different offsets never skip or repeat near ties and agree with FindTopDocumentsAfter
+    template <typename DocumentPredicate, typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, const std::string_view& raw_query,
+    		DocumentPredicate document_predicate, size_t offset, size_t limit) const {
+        const Query query = ParseQuery(raw_query);
+        const size_t top_count = limit > std::numeric_limits<size_t>::max() - offset ? std::numeric_limits<size_t>::max() : offset + limit;
+        std::vector<Document> matched_documents = FindAllDocuments(std::forward<ExecutionPolicy>(policy), query, document_predicate,
+        		top_count);
+        SelectPage(matched_documents, offset, limit, IsRankedBeforeExact);
+        return matched_documents;
+    }
+
+    // Returns up to limit documents ranked strictly after last, the final document of the previous page.
+    // Cursor pages follow IsRankedBeforeExact, as the tolerance of IsRankedBefore is not transitive and could
+    // skip or repeat near ties across pages; start the walk from FIRST_PAGE_CURSOR
+    template <typename DocumentPredicate, typename ExecutionPolicy>
+    std::vector<Document> FindTopDocumentsAfter(ExecutionPolicy&& policy, const std::string_view& raw_query,
+    		DocumentPredicate document_predicate, const Document& last, size_t limit) const {
+        const Query query = ParseQuery(raw_query);
+        std::vector<Document> matched_documents = FindAllDocuments(std::forward<ExecutionPolicy>(policy), query, document_predicate);
+        const auto tail = std::partition(matched_documents.begin(), matched_documents.end(), [&last](const Document& document) {
+        	return IsRankedBeforeExact(last, document);
         });
-        if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-            matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
-        }
+        matched_documents.erase(tail, matched_documents.end());
+        SelectPage(matched_documents, 0, limit, IsRankedBeforeExact);
         return matched_documents;
     }
 
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocumentsAfter(const std::string_view& raw_query, DocumentPredicate document_predicate,
+    		const Document& last, size_t limit) const {
+    	return FindTopDocumentsAfter(std::execution::seq, raw_query, document_predicate, last, limit);
+    }
+
+    std::vector<Document> FindTopDocumentsAfter(const std::string_view& raw_query, const Document& last, size_t limit) const;
+
     template <typename DocumentPredicate>
     std::vector<Document> FindTopDocuments(const std::string_view& raw_query, DocumentPredicate document_predicate) const {
     	return FindTopDocuments(std::execution::seq, raw_query, document_predicate);
     }
 
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(const std::string_view& raw_query, DocumentPredicate document_predicate,
+    		size_t offset, size_t limit) const {
+    	return FindTopDocuments(std::execution::seq, raw_query, document_predicate, offset, limit);
+    }
+
     template <typename ExecutionPolicy>
     std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, const std::string_view& raw_query, DocumentStatus status) const {
-        return FindTopDocuments(std::forward<ExecutionPolicy>(policy), raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
+        return FindTopDocuments(std::forward<ExecutionPolicy>(policy), raw_query, [status](int, DocumentStatus document_status, int) {
         	return document_status == status;
         });
     }
@@ -75,10 +132,19 @@ public:
 
     std::vector<Document> FindTopDocuments(const std::string_view& raw_query, DocumentStatus status) const;
     std::vector<Document> FindTopDocuments(const std::string_view& raw_query) const;
+    // Selects the documents of FindTopDocuments(raw_query) straight into out instead of a new vector,
+    // at most out.size() of them; returns how many were written
+    size_t FindTopDocumentsInto(const std::string_view& raw_query, std::span<Document> out) const;
     int GetDocumentCount() const;
-    std::set<int>::const_iterator begin() const;
-    std::set<int>::const_iterator end() const;
-    const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
+    std::pmr::set<int>::const_iterator begin() const;
+    std::pmr::set<int>::const_iterator end() const;
+    // Allocation free view into the forward index, empty for an unknown document; safe with concurrent readers
+    DocumentTerms GetWordFrequencies(int document_id) const;
+    DocumentStatus GetDocumentStatus(int document_id) const;
+    int GetDocumentRating(int document_id) const;
+    // Inserts a document from previously indexed term frequencies, e.g. when loading a checkpoint
+    void RestoreDocument(int document_id, DocumentStatus status, int rating,
+    		const std::map<std::string_view, double>& word_freqs);
     void RemoveDocument(int document_id);
     void RemoveDocument(const std::execution::sequenced_policy& policy, int document_id);
     void RemoveDocument(const std::execution::parallel_policy& polic, int document_id);
@@ -89,108 +155,358 @@ public:
     			const std::string_view& raw_query, int document_id) const;
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::string_view& raw_query, int document_id) const;
 
+    // Matches the query against every document in document_ids, parsing the query once
+    template <typename ExecutionPolicy>
+    MatchedDocuments MatchDocuments(ExecutionPolicy&& policy, const std::string_view& raw_query,
+    		const std::vector<int>& document_ids) const {
+        const Query query = ParseQuery(raw_query);
+        const std::vector<TermRef> plus_terms = ResolveTerms(query.plus_words);
+        const std::vector<TermRef> minus_terms = ResolveTerms(query.minus_words);
+
+        MatchedDocuments result;
+        result.document_ids = document_ids;
+        result.statuses.reserve(document_ids.size());
+        for (const int document_id : document_ids) {
+            result.statuses.push_back(documents_.at(document_id).status);
+        }
+
+        std::vector<size_t> indexes(document_ids.size());
+        std::iota(indexes.begin(), indexes.end(), 0);
+        std::vector<size_t> match_counts(document_ids.size() + 1, 0);
+        std::for_each(policy, indexes.begin(), indexes.end(), [&](size_t index) {
+            const auto& term_ids = forward_index_.at(document_ids[index]).term_ids;
+            const auto contains = [&term_ids](const TermRef& term) {
+                return std::binary_search(term_ids.begin(), term_ids.end(), term.id);
+            };
+            if (std::none_of(minus_terms.begin(), minus_terms.end(), contains)) {
+                match_counts[index] = std::count_if(plus_terms.begin(), plus_terms.end(), contains);
+            }
+        });
+
+        result.offsets.resize(match_counts.size());
+        std::exclusive_scan(match_counts.begin(), match_counts.end(), result.offsets.begin(), size_t{0});
+        result.words.resize(result.offsets.back());
+        std::for_each(policy, indexes.begin(), indexes.end(), [&](size_t index) {
+            if (match_counts[index] == 0) {
+                return;
+            }
+            const auto& term_ids = forward_index_.at(document_ids[index]).term_ids;
+            auto output = result.words.begin() + result.offsets[index];
+            for (const TermRef& term : plus_terms) {
+                if (std::binary_search(term_ids.begin(), term_ids.end(), term.id)) {
+                    *output++ = term.data;
+                }
+            }
+        });
+        return result;
+    }
+
+    MatchedDocuments MatchDocuments(const std::string_view& raw_query, const std::vector<int>& document_ids) const;
+
+    // Plan that FindTopDocuments would execute for the query, like EXPLAIN
+    QueryPlan ExplainQuery(const std::execution::sequenced_policy& policy, const std::string_view& raw_query) const;
+    QueryPlan ExplainQuery(const std::execution::parallel_policy& policy, const std::string_view& raw_query) const;
+    QueryPlan ExplainQuery(const std::string_view& raw_query) const;
+
+    // Bytes requested by the index containers of every server on the context
+    MemoryStats GetIndexMemoryStats() const;
+    // Bytes the context pool holds from the upstream resource
+    MemoryStats GetReservedMemoryStats() const;
+    const std::shared_ptr<SearchContext>& GetContext() const;
+
 private:
     struct DocumentData {
         int rating;
         DocumentStatus status;
+        uint32_t slot;
     };
-    struct QueryWord {
+    using Query = SearchQuery;
+    struct TermRef {
+        int id;
         std::string_view data;
-        bool is_minus;
-        bool is_stop;
     };
-    struct Query {
-        std::set<std::string_view> plus_words;
-        std::set<std::string_view> minus_words;
+    // Terms of a document sorted by term id, words point into the term dictionary
+    struct ForwardIndexEntry {
+        using allocator_type = std::pmr::polymorphic_allocator<>;
+
+        explicit ForwardIndexEntry(const allocator_type& allocator)
+        	: term_ids(allocator)
+        	, words(allocator)
+        	, term_freqs(allocator)
+        {
+        }
+
+        std::pmr::vector<int> term_ids;
+        std::pmr::vector<std::string_view> words;
+        std::pmr::vector<double> term_freqs;
     };
-    const std::set<std::string, std::less<>> stop_words_;
-    std::map<std::string, std::map<int, double>> word_to_document_freqs_;
-    std::map<int, std::map<std::string, double>> document_to_word_freqs_;
-    std::map<int, DocumentData> documents_;
-    std::set<int> document_ids_;
+    std::shared_ptr<SearchContext> context_;
+    // keys point into the term dictionary of the context
+    std::pmr::map<std::string_view, std::pmr::map<int, double>, std::less<>> word_to_document_freqs_{context_->GetResource()};
+    std::pmr::map<int, DocumentData> documents_{context_->GetResource()};
+    std::pmr::set<int> document_ids_{context_->GetResource()};
+    std::pmr::map<int, ForwardIndexEntry> forward_index_{context_->GetResource()};
+    std::pmr::vector<int> slot_to_document_id_{context_->GetResource()};
+    std::pmr::vector<uint32_t> free_slots_{context_->GetResource()};
 
     bool IsStopWord(const std::string_view& word) const;
-    static bool IsValidWord(const std::string_view& word);
-    std::vector<std::string> SplitIntoWordsNoStop(const std::string_view& text) const;
+    std::vector<std::string_view> SplitIntoWordsNoStop(const std::string_view& text) const;
     static int ComputeAverageRating(const std::vector<int>& ratings);
-    QueryWord ParseQueryWord(std::string_view text) const;
     Query ParseQuery(const std::string_view& text) const;
+    std::vector<TermRef> ResolveTerms(const std::set<std::string_view>& words) const;
+    uint32_t AcquireSlot(int document_id);
+    void ReleaseSlot(uint32_t slot);
+    void IndexTerms(int document_id, std::vector<std::pair<TermDictionary::Term, double>>& term_freqs);
+    void ReleaseTerms(const ForwardIndexEntry& entry);
 
-    double ComputeWordInverseDocumentFreq(const std::string& word) const;
+    double ComputeWordInverseDocumentFreq(const std::string_view& word) const;
 
-    template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const std::execution::sequenced_policy& policy, const Query& query,
-    		DocumentPredicate document_predicate) const {
-        std::map<int, double> document_to_relevance;
-        for (const std::string_view& word : query.plus_words) {
-            if (word_to_document_freqs_.count({word.begin(), word.end()}) == 0) {
-                continue;
+    static void SelectPage(std::vector<Document>& documents, size_t offset, size_t limit,
+    		bool (*is_ranked_before)(const Document&, const Document&) = IsRankedBefore);
+
+    using Postings = std::pmr::map<int, double>;
+
+    // Documents dropped by minus words: a bitmap over document ids, or a sorted id list when ids are sparse
+    class ExcludedDocuments {
+    public:
+        void Assign(std::vector<int> ids, int max_document_id) {
+            std::sort(ids.begin(), ids.end());
+            ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+            count_ = ids.size();
+            bitmap_.clear();
+            sorted_ids_.clear();
+            if (ids.empty()) {
+                return;
             }
-            const double inverse_document_freq = ComputeWordInverseDocumentFreq({word.begin(), word.end()});
-            for (const auto [document_id, term_freq] : word_to_document_freqs_.at({word.begin(), word.end()})) {
-                const auto& document_data = documents_.at(document_id);
-                if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                    document_to_relevance[document_id] += term_freq * inverse_document_freq;
+            if (static_cast<size_t>(max_document_id) <= ids.size() * 64) {
+                bitmap_.assign(static_cast<size_t>(max_document_id) + 1, false);
+                for (const int id : ids) {
+                    bitmap_[id] = true;
                 }
+            } else {
+                sorted_ids_ = std::move(ids);
             }
         }
-        for (const std::string_view& word : query.minus_words) {
-            if (word_to_document_freqs_.count({word.begin(), word.end()}) == 0) {
-                continue;
+
+        bool Contains(int document_id) const {
+            if (count_ == 0) {
+                return false;
             }
-            for (const auto [document_id, _] : word_to_document_freqs_.at({word.begin(), word.end()})) {
-                document_to_relevance.erase(document_id);
+            if (!bitmap_.empty()) {
+                return static_cast<size_t>(document_id) < bitmap_.size() && bitmap_[document_id];
             }
+            return std::binary_search(sorted_ids_.begin(), sorted_ids_.end(), document_id);
+        }
+
+        size_t size() const {
+            return count_;
         }
 
+    private:
+        std::vector<bool> bitmap_;
+        std::vector<int> sorted_ids_;
+        size_t count_ = 0;
+    };
+
+    struct PlannedQuery {
+        QueryPlan plan;
+        std::vector<const Postings*> plus_postings;
+        ExcludedDocuments excluded;
+        SearchContext::ParallelPermit parallel_permit;
+    };
+
+    PlannedQuery PlanQuery(const Query& query, bool allow_parallel) const;
+
+    // Adds terms in plan order; the products are rounded before each addition only with -ffp-contract=off,
+    // which the segmented server and the scoring kernels rely on to reproduce these sums
+    template <typename DocumentPredicate>
+    void AccumulateRelevance(const PlannedQuery& planned, DocumentPredicate document_predicate,
+    		std::map<int, double>& document_to_relevance, int first_id, int64_t end_id) const {
+        for (size_t i = 0; i < planned.plus_postings.size(); ++i) {
+            const Postings& postings = *planned.plus_postings[i];
+            const double inverse_document_freq = planned.plan.plus_terms[i].inverse_document_freq;
+            for (auto it = postings.lower_bound(first_id); it != postings.end() && it->first < end_id; ++it) {
+                const auto [document_id, term_freq] = *it;
+                if (planned.excluded.Contains(document_id)) {
+                    continue;
+                }
+                const auto& document_data = documents_.at(document_id);
+                if (document_predicate(document_id, document_data.status, document_data.rating)) {
+                    document_to_relevance[document_id] += term_freq * inverse_document_freq;
+                }
+            }
+        }
+    }
+
+    template <typename DocumentPredicate>
+    std::vector<Document> ExecuteSequential(const PlannedQuery& planned, DocumentPredicate document_predicate) const {
+        std::map<int, double> document_to_relevance;
+        AccumulateRelevance(planned, document_predicate, document_to_relevance,
+        		std::numeric_limits<int>::min(), int64_t{std::numeric_limits<int>::max()} + 1);
+
         std::vector<Document> matched_documents;
-        for (const auto [document_id, relevance] : document_to_relevance) {
+        matched_documents.reserve(document_to_relevance.size());
+        for (const auto& [document_id, relevance] : document_to_relevance) {
             matched_documents.push_back({document_id, relevance, documents_.at(document_id).rating});
         }
         return matched_documents;
     }
 
     template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const std::execution::parallel_policy& policy, const Query& query,
-    		DocumentPredicate document_predicate) const {
-
-    	ConcurrentMap<int, double> document_to_relevance(4);
+    std::vector<Document> ExecuteParallel(const PlannedQuery& planned, DocumentPredicate document_predicate) const {
+    	ConcurrentMap<int, double> document_to_relevance;
+    	std::vector<size_t> term_indexes(planned.plus_postings.size());
+    	std::iota(term_indexes.begin(), term_indexes.end(), 0);
 
     	std::for_each(
     			std::execution::par,
-				query.plus_words.begin(), query.plus_words.end(),
-						[&](const std::string_view& word){
-
-						if (word_to_document_freqs_.count({word.begin(), word.end()}) > 0){
-							const double inverse_document_freq = ComputeWordInverseDocumentFreq({word.begin(), word.end()});
-
-				            for (const auto [document_id, term_freq] : word_to_document_freqs_.at({word.begin(), word.end()})) {
-				                const auto& document_data = documents_.at(document_id);
-				                if (document_predicate(document_id, document_data.status, document_data.rating)) {
-				                	document_to_relevance[document_id].ref_to_value += term_freq * inverse_document_freq;
-				                }
-				            }
-						}
+				term_indexes.begin(), term_indexes.end(),
+						[&](size_t i){
+						const double inverse_document_freq = planned.plan.plus_terms[i].inverse_document_freq;
+			            for (const auto& [document_id, term_freq] : *planned.plus_postings[i]) {
+			            	if (planned.excluded.Contains(document_id)) {
+			            		continue;
+			            	}
+			                const auto& document_data = documents_.at(document_id);
+			                if (document_predicate(document_id, document_data.status, document_data.rating)) {
+			                	document_to_relevance.Add(document_id, term_freq * inverse_document_freq);
+			                }
+			            }
     	});
 
-    	std::for_each(
-    			std::execution::par,
-				query.minus_words.begin(), query.minus_words.end(),
-						[&](const std::string_view& word){
+        std::vector<Document> matched_documents;
+        matched_documents.reserve(document_to_relevance.size());
+        document_to_relevance.ForEach([&](int document_id, double relevance) {
+            matched_documents.push_back({document_id, relevance, documents_.at(document_id).rating});
+        });
+        return matched_documents;
+    }
 
-    					if (word_to_document_freqs_.count({word.begin(), word.end()}) > 0) {
-        					for (const auto [document_id, _] : word_to_document_freqs_.at({word.begin(), word.end()})) {
-        						document_to_relevance.erase(document_id);
-        					}
-    					}
+    // Splits the document id space at quantiles of the longest posting list, each shard accumulates without locks
+    template <typename DocumentPredicate>
+    std::vector<Document> ExecuteSharded(const PlannedQuery& planned, DocumentPredicate document_predicate) const {
+        const Postings& longest = *planned.plus_postings.back();
+        const size_t shard_count = planned.plan.shard_count;
+        std::vector<int64_t> bounds;
+        bounds.push_back(std::numeric_limits<int>::min());
+        const size_t step = std::max<size_t>(1, longest.size() / shard_count);
+        size_t position = 0;
+        for (const auto& [document_id, _] : longest) {
+            if (position > 0 && position % step == 0 && bounds.size() < shard_count) {
+                bounds.push_back(document_id);
+            }
+            ++position;
+        }
+        bounds.push_back(int64_t{std::numeric_limits<int>::max()} + 1);
 
-    	});
+        std::vector<std::vector<Document>> shard_documents(bounds.size() - 1);
+        std::vector<size_t> shard_indexes(shard_documents.size());
+        std::iota(shard_indexes.begin(), shard_indexes.end(), 0);
+        std::for_each(std::execution::par, shard_indexes.begin(), shard_indexes.end(), [&](size_t shard) {
+            std::map<int, double> document_to_relevance;
+            AccumulateRelevance(planned, document_predicate, document_to_relevance,
+            		static_cast<int>(bounds[shard]), bounds[shard + 1]);
+            std::vector<Document>& documents = shard_documents[shard];
+            documents.reserve(document_to_relevance.size());
+            for (const auto& [document_id, relevance] : document_to_relevance) {
+                documents.push_back({document_id, relevance, documents_.at(document_id).rating});
+            }
+        });
 
         std::vector<Document> matched_documents;
-        for (const auto [document_id, relevance] : document_to_relevance.BuildOrdinaryMap()) {
-            matched_documents.push_back({document_id, relevance, documents_.at(document_id).rating});
+        for (const std::vector<Document>& documents : shard_documents) {
+            matched_documents.insert(matched_documents.end(), documents.begin(), documents.end());
+        }
+        return matched_documents;
+    }
+
+    // Accumulates into an array indexed by document slot and returns only documents that can reach the top top_count:
+    // one scoring more than 1e-6 below the top_count-th best relevance is ranked after all of them
+    template <typename DocumentPredicate>
+    std::vector<Document> ExecuteDense(const PlannedQuery& planned, DocumentPredicate document_predicate,
+    		size_t top_count) const {
+        const size_t slot_count = slot_to_document_id_.size();
+        std::vector<double> scores(slot_count, 0.0);
+        std::vector<uint8_t> matched(slot_count, 0);
+        std::vector<uint32_t> block_slots;
+        std::vector<double> block_term_freqs;
+        block_slots.reserve(SCORING_BLOCK_SIZE * 32);
+        block_term_freqs.reserve(SCORING_BLOCK_SIZE * 32);
+        size_t matched_count = 0;
+
+        for (size_t i = 0; i < planned.plus_postings.size(); ++i) {
+            const double inverse_document_freq = planned.plan.plus_terms[i].inverse_document_freq;
+            for (const auto& [document_id, term_freq] : *planned.plus_postings[i]) {
+                if (planned.excluded.Contains(document_id)) {
+                    continue;
+                }
+                const auto& document_data = documents_.at(document_id);
+                if (!document_predicate(document_id, document_data.status, document_data.rating)) {
+                    continue;
+                }
+                matched_count += matched[document_data.slot] == 0;
+                matched[document_data.slot] = 1;
+                block_slots.push_back(document_data.slot);
+                block_term_freqs.push_back(term_freq);
+                if (block_slots.size() == block_slots.capacity()) {
+                    AccumulateScores(scores.data(), block_slots.data(), block_term_freqs.data(), block_slots.size(), inverse_document_freq);
+                    block_slots.clear();
+                    block_term_freqs.clear();
+                }
+            }
+            // a block never spans two terms, so slots stay unique within one kernel call
+            AccumulateScores(scores.data(), block_slots.data(), block_term_freqs.data(), block_slots.size(), inverse_document_freq);
+            block_slots.clear();
+            block_term_freqs.clear();
+        }
+
+        double threshold = -std::numeric_limits<double>::infinity();
+        if (top_count > 0 && top_count < matched_count) {
+            std::vector<double> maxima((slot_count + SCORING_BLOCK_SIZE - 1) / SCORING_BLOCK_SIZE);
+            ComputeBlockMaxima(scores.data(), slot_count, maxima.data());
+            if (maxima.size() >= top_count) {
+                std::nth_element(maxima.begin(), maxima.begin() + (top_count - 1), maxima.end(), std::greater<>());
+                threshold = maxima[top_count - 1] - 1e-6;
+            }
         }
+        std::vector<uint32_t> candidates(matched_count);
+        candidates.resize(CollectCandidates(scores.data(), matched.data(), slot_count, threshold, candidates.data()));
 
+        std::vector<Document> matched_documents;
+        matched_documents.reserve(candidates.size());
+        for (const uint32_t slot : candidates) {
+            const int document_id = slot_to_document_id_[slot];
+            matched_documents.push_back({document_id, scores[slot], documents_.at(document_id).rating});
+        }
         return matched_documents;
     }
+
+    template <typename DocumentPredicate>
+    std::vector<Document> ExecutePlan(const PlannedQuery& planned, DocumentPredicate document_predicate,
+    		size_t top_count) const {
+        switch (planned.plan.execution) {
+        case QueryExecution::PARALLEL:
+            return ExecuteParallel(planned, document_predicate);
+        case QueryExecution::SHARDED:
+            return ExecuteSharded(planned, document_predicate);
+        default:
+            if (planned.plan.dense_scores) {
+                return ExecuteDense(planned, document_predicate, top_count);
+            }
+            return ExecuteSequential(planned, document_predicate);
+        }
+    }
+
+    // With a top_count the result may omit documents that cannot be among the best top_count
+    template <typename DocumentPredicate>
+    std::vector<Document> FindAllDocuments(const std::execution::sequenced_policy&, const Query& query,
+    		DocumentPredicate document_predicate, size_t top_count = std::numeric_limits<size_t>::max()) const {
+        return ExecutePlan(PlanQuery(query, false), document_predicate, top_count);
+    }
+
+    template <typename DocumentPredicate>
+    std::vector<Document> FindAllDocuments(const std::execution::parallel_policy&, const Query& query,
+    		DocumentPredicate document_predicate, size_t top_count = std::numeric_limits<size_t>::max()) const {
+        return ExecutePlan(PlanQuery(query, true), document_predicate, top_count);
+    }
 };
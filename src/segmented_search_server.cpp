@@ -0,0 +1,412 @@
+#include "segmented_search_server.h"
+
+#include "string_processing.h"
+
+#include <stdexcept>
+
+SegmentedSearchServer::SegmentedSearchServer(const std::string_view& stop_words_text, const SegmentedIndexOptions& options)
+    : SegmentedSearchServer(SplitIntoWords(stop_words_text), options)
+{
+}
+
+SegmentedSearchServer::SegmentedSearchServer(const std::string& stop_words_text, const SegmentedIndexOptions& options)
+    : SegmentedSearchServer(SplitIntoWords(stop_words_text), options)
+{
+}
+
+SegmentedSearchServer::SegmentedSearchServer(std::shared_ptr<SearchContext> context, const SegmentedIndexOptions& options)
+    : context_(RequireContext(std::move(context)))
+    , options_(options)
+{
+    if (options_.max_hot_documents == 0 || options_.merge_factor < 2) {
+    	throw std::invalid_argument("segment size must be positive and merge factor at least 2");
+    }
+    if (options_.background_merges) {
+    	merge_thread_ = std::thread([this] {
+    		MergeLoop();
+    	});
+    }
+}
+
+SegmentedSearchServer::~SegmentedSearchServer() {
+    {
+    	std::lock_guard lock(segments_mutex_);
+    	stopping_ = true;
+    }
+    merge_cv_.notify_all();
+    if (merge_thread_.joinable()) {
+    	merge_thread_.join();
+    }
+    for (const auto& [_, document] : hot_documents_) {
+    	ReleaseTerms(document.term_ids);
+    }
+    for (const std::shared_ptr<IndexSegment>& segment : segments_) {
+    	for (uint32_t index = 0; index < segment->GetDocumentCount(); ++index) {
+    		ReleaseTerms(segment->GetTermIds(index));
+    	}
+    }
+}
+
+void SegmentedSearchServer::AddDocument(int document_id, const std::string_view& document, DocumentStatus status, const std::vector<int>& ratings) {
+    if ((document_id < 0) || ContainsDocument(document_id)) {
+    	throw std::invalid_argument("document id is negative or already exists");
+    }
+    const std::vector<std::string_view> words = context_->SplitIntoWordsNoStop(document);
+    if (!std::all_of(words.begin(), words.end(), IsValidWord)) {
+    	throw std::invalid_argument("Word has illegal characters");
+    }
+
+    // same summation as SearchServer, so term frequencies are bit-identical to it;
+    // the document holds one dictionary reference per distinct word until it leaves every segment
+    std::vector<std::string_view> sorted_words = words;
+    std::sort(sorted_words.begin(), sorted_words.end());
+    std::vector<std::pair<int, double>> term_freqs;
+    for (auto it = sorted_words.begin(); it != sorted_words.end(); ) {
+    	double term_freq = 0.0;
+    	const std::string_view word = *it;
+    	for (; it != sorted_words.end() && *it == word; ++it) {
+    		term_freq += 1.0 / words.size();
+    	}
+    	term_freqs.push_back({context_->GetTerms().Intern(word).id, term_freq});
+    }
+    std::sort(term_freqs.begin(), term_freqs.end());
+
+    HotDocument hot_document{ComputeAverageRating(ratings), status, {}, {}};
+    for (const auto& [term_id, term_freq] : term_freqs) {
+    	hot_document.term_ids.push_back(term_id);
+    	hot_document.term_freqs.push_back(term_freq);
+    	hot_postings_[term_id].push_back({document_id, term_freq});
+    }
+    hot_documents_.emplace(document_id, std::move(hot_document));
+    ++document_count_;
+
+    if (hot_documents_.size() >= options_.max_hot_documents) {
+    	FreezeHotSegment();
+    }
+}
+
+void SegmentedSearchServer::RemoveDocument(int document_id) {
+    const auto hot_it = hot_documents_.find(document_id);
+    if (hot_it != hot_documents_.end()) {
+    	for (const int term_id : hot_it->second.term_ids) {
+    		std::vector<HotPosting>& postings = hot_postings_.at(term_id);
+    		postings.erase(std::find_if(postings.begin(), postings.end(), [document_id](const HotPosting& posting) {
+    			return posting.document_id == document_id;
+    		}));
+    		if (postings.empty()) {
+    			hot_postings_.erase(term_id);
+    		}
+    		context_->GetTerms().Release(term_id);
+    	}
+    	hot_documents_.erase(hot_it);
+    	--document_count_;
+    	return;
+    }
+
+    std::unique_lock lock(segments_mutex_);
+    for (const std::shared_ptr<IndexSegment>& segment : segments_) {
+    	if (const auto index = segment->FindDocument(document_id)) {
+    		segment->MarkDeleted(*index);
+    		--document_count_;
+    		ScheduleMerges(lock);
+    		return;
+    	}
+    }
+}
+
+std::vector<Document> SegmentedSearchServer::FindTopDocuments(const std::string_view& raw_query, DocumentStatus status) const {
+    return FindTopDocuments(std::execution::seq, raw_query, status);
+}
+
+std::vector<Document> SegmentedSearchServer::FindTopDocuments(const std::string_view& raw_query) const {
+    return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+}
+
+ApproximateDocuments SegmentedSearchServer::FindTopDocumentsApproximate(const std::string_view& raw_query, DocumentStatus status,
+		const ApproximateQueryOptions& options) const {
+    return FindTopDocumentsApproximate(raw_query, [status](int, DocumentStatus document_status, int) {
+    	return document_status == status;
+    }, options);
+}
+
+ApproximateDocuments SegmentedSearchServer::FindTopDocumentsApproximate(const std::string_view& raw_query,
+		const ApproximateQueryOptions& options) const {
+    return FindTopDocumentsApproximate(raw_query, DocumentStatus::ACTUAL, options);
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> SegmentedSearchServer::MatchDocument(const std::string_view& raw_query, int document_id) const {
+    const SearchQuery query = context_->ParseQuery(raw_query);
+
+    std::shared_ptr<IndexSegment> segment;
+    std::span<const int> term_ids;
+    DocumentStatus status;
+    if (const auto hot_it = hot_documents_.find(document_id); hot_it != hot_documents_.end()) {
+    	term_ids = hot_it->second.term_ids;
+    	status = hot_it->second.status;
+    } else {
+    	std::lock_guard lock(segments_mutex_);
+    	for (const std::shared_ptr<IndexSegment>& candidate : segments_) {
+    		if (const auto index = candidate->FindDocument(document_id)) {
+    			segment = candidate;
+    			term_ids = segment->GetTermIds(*index);
+    			status = segment->GetStatus(*index);
+    			break;
+    		}
+    	}
+    	if (!segment) {
+    		throw std::out_of_range("document is not found");
+    	}
+    }
+
+    const auto is_in_document = [this, term_ids](const std::string_view& word) {
+    	const auto term = context_->GetTerms().Find(word);
+    	return term && std::binary_search(term_ids.begin(), term_ids.end(), term->id);
+    };
+    if (std::any_of(query.minus_words.begin(), query.minus_words.end(), is_in_document)) {
+    	return {std::vector<std::string_view>{}, status};
+    }
+    std::vector<std::string_view> matched_words;
+    std::copy_if(query.plus_words.begin(), query.plus_words.end(), std::back_inserter(matched_words), is_in_document);
+    return {matched_words, status};
+}
+
+int SegmentedSearchServer::GetDocumentCount() const {
+    return document_count_;
+}
+
+void SegmentedSearchServer::Flush() {
+    FreezeHotSegment();
+}
+
+void SegmentedSearchServer::WaitForMerges() {
+    std::unique_lock lock(segments_mutex_);
+    merge_cv_.wait(lock, [this] {
+    	return !merging_ && PickMerge().empty();
+    });
+}
+
+void SegmentedSearchServer::ForceMerge() {
+    FreezeHotSegment();
+    std::unique_lock lock(segments_mutex_);
+    merge_cv_.wait(lock, [this] {
+    	return !merging_;
+    });
+    const bool has_deletions = std::any_of(segments_.begin(), segments_.end(), [](const std::shared_ptr<IndexSegment>& segment) {
+    	return segment->GetLiveDocumentCount() < segment->GetDocumentCount();
+    });
+    if (segments_.size() > 1 || has_deletions) {
+    	const std::vector<std::shared_ptr<IndexSegment>> sources = segments_;
+    	merging_ = true;
+    	Merge(lock, sources);
+    }
+}
+
+SegmentStats SegmentedSearchServer::GetSegmentStats() const {
+    SegmentStats stats;
+    stats.hot_documents = hot_documents_.size();
+    std::lock_guard lock(segments_mutex_);
+    for (const std::shared_ptr<IndexSegment>& segment : segments_) {
+    	stats.segment_documents.push_back(segment->GetLiveDocumentCount());
+    }
+    stats.merges_completed = merges_completed_;
+    return stats;
+}
+
+SegmentedSearchServer::ResolvedQuery SegmentedSearchServer::ResolveQuery(const SearchQuery& query) const {
+    ResolvedQuery resolved;
+    {
+    	std::lock_guard lock(segments_mutex_);
+    	resolved.segments = segments_;
+    }
+
+    // document frequencies count live documents of all segments, so IDF does not depend on the segment layout;
+    // segments keep them per term, so this costs a lookup per segment rather than a walk over postings
+    const auto count_documents = [this, &resolved](int term_id) {
+    	size_t document_count = 0;
+    	for (const std::shared_ptr<IndexSegment>& segment : resolved.segments) {
+    		document_count += segment->GetLiveDocumentFrequency(term_id);
+    	}
+    	if (const auto it = hot_postings_.find(term_id); it != hot_postings_.end()) {
+    		document_count += it->second.size();
+    	}
+    	return document_count;
+    };
+
+    std::vector<std::pair<QueryTerm, size_t>> plus_terms;
+    for (const std::string_view& word : query.plus_words) {
+    	const auto term = context_->GetTerms().Find(word);
+    	if (!term) {
+    		continue;
+    	}
+    	const size_t document_count = count_documents(term->id);
+    	if (document_count == 0) {
+    		continue;
+    	}
+    	plus_terms.push_back({{word, term->id, std::log(GetDocumentCount() * 1.0 / document_count)}, document_count});
+    }
+    std::stable_sort(plus_terms.begin(), plus_terms.end(), [](const auto& lhs, const auto& rhs) {
+    	return lhs.second < rhs.second;
+    });
+    for (const auto& [term, _] : plus_terms) {
+    	resolved.plus_terms.push_back(term);
+    }
+
+    for (const std::string_view& word : query.minus_words) {
+    	if (const auto term = context_->GetTerms().Find(word)) {
+    		resolved.minus_term_ids.push_back(term->id);
+    	}
+    }
+    return resolved;
+}
+
+bool SegmentedSearchServer::ContainsDocument(int document_id) const {
+    if (hot_documents_.count(document_id) > 0) {
+    	return true;
+    }
+    std::lock_guard lock(segments_mutex_);
+    return std::any_of(segments_.begin(), segments_.end(), [document_id](const std::shared_ptr<IndexSegment>& segment) {
+    	return segment->FindDocument(document_id).has_value();
+    });
+}
+
+void SegmentedSearchServer::FreezeHotSegment() {
+    if (hot_documents_.empty()) {
+    	return;
+    }
+    std::vector<SegmentDocument> documents;
+    documents.reserve(hot_documents_.size());
+    for (const auto& [document_id, document] : hot_documents_) {
+    	documents.push_back({document_id, document.rating, document.status, document.term_ids, document.term_freqs});
+    }
+    std::shared_ptr<IndexSegment> segment = IndexSegment::Build(std::move(documents), context_->GetResource());
+    hot_documents_.clear();
+    hot_postings_.clear();
+
+    std::unique_lock lock(segments_mutex_);
+    segments_.push_back(std::move(segment));
+    ScheduleMerges(lock);
+}
+
+void SegmentedSearchServer::ReleaseTerms(std::span<const int> term_ids) {
+    for (const int term_id : term_ids) {
+    	context_->GetTerms().Release(term_id);
+    }
+}
+
+int SegmentedSearchServer::ComputeAverageRating(const std::vector<int>& ratings) {
+    if (ratings.empty()) {
+        return 0;
+    }
+    int rating_sum = 0;
+    for (const int rating : ratings) {
+        rating_sum += rating;
+    }
+    return rating_sum / static_cast<int>(ratings.size());
+}
+
+void SegmentedSearchServer::DistributePostingBudget(std::vector<size_t>& quotas, size_t budget) {
+    std::vector<size_t> order(quotas.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&quotas](size_t lhs, size_t rhs) {
+    	return quotas[lhs] < quotas[rhs];
+    });
+    size_t remaining = budget;
+    for (size_t i = 0; i < order.size(); ++i) {
+    	size_t& quota = quotas[order[i]];
+    	quota = std::min(quota, remaining / (order.size() - i));
+    	remaining -= quota;
+    }
+}
+
+size_t SegmentedSearchServer::GetTier(size_t document_count) const {
+    size_t tier = 0;
+    for (size_t limit = options_.max_hot_documents; document_count > limit; limit *= options_.merge_factor) {
+    	++tier;
+    }
+    return tier;
+}
+
+std::vector<std::shared_ptr<IndexSegment>> SegmentedSearchServer::PickMerge() const {
+    // a segment which is mostly removed documents is rewritten alone to reclaim its memory
+    for (const std::shared_ptr<IndexSegment>& segment : segments_) {
+    	if ((segment->GetDocumentCount() - segment->GetLiveDocumentCount()) * 2 > segment->GetDocumentCount()) {
+    		return {segment};
+    	}
+    }
+    std::map<size_t, std::vector<std::shared_ptr<IndexSegment>>> tiers;
+    for (const std::shared_ptr<IndexSegment>& segment : segments_) {
+    	std::vector<std::shared_ptr<IndexSegment>>& tier = tiers[GetTier(segment->GetLiveDocumentCount())];
+    	tier.push_back(segment);
+    	if (tier.size() == options_.merge_factor) {
+    		return tier;
+    	}
+    }
+    return {};
+}
+
+void SegmentedSearchServer::ScheduleMerges(std::unique_lock<std::mutex>& lock) {
+    if (options_.background_merges) {
+    	merge_cv_.notify_all();
+    	return;
+    }
+    for (auto sources = PickMerge(); !sources.empty(); sources = PickMerge()) {
+    	merging_ = true;
+    	Merge(lock, sources);
+    }
+}
+
+void SegmentedSearchServer::Merge(std::unique_lock<std::mutex>& lock, const std::vector<std::shared_ptr<IndexSegment>>& sources) {
+    std::vector<SegmentDocument> documents;
+    std::vector<std::pair<IndexSegment*, uint32_t>> origins;
+    std::vector<std::pair<IndexSegment*, uint32_t>> dropped;
+    for (const std::shared_ptr<IndexSegment>& source : sources) {
+    	for (uint32_t index = 0; index < source->GetDocumentCount(); ++index) {
+    		if (!source->IsDeleted(index)) {
+    			documents.push_back(source->GetDocument(index));
+    			origins.push_back({source.get(), index});
+    		} else {
+    			dropped.push_back({source.get(), index});
+    		}
+    	}
+    }
+
+    // sources are immutable apart from deletion marks, so they are read without the lock
+    lock.unlock();
+    std::shared_ptr<IndexSegment> merged = IndexSegment::Build(std::move(documents), context_->GetResource());
+    lock.lock();
+
+    // documents removed while the merge was building
+    for (const auto& [source, index] : origins) {
+    	if (source->IsDeleted(index)) {
+    		merged->MarkDeleted(*merged->FindDocument(source->GetDocumentId(index)));
+    	}
+    }
+    std::erase_if(segments_, [&sources](const std::shared_ptr<IndexSegment>& segment) {
+    	return std::find(sources.begin(), sources.end(), segment) != sources.end();
+    });
+    if (merged->GetDocumentCount() > 0) {
+    	segments_.push_back(std::move(merged));
+    }
+    // ids are never reused, so queries still holding the sources cannot match a released term
+    for (const auto& [source, index] : dropped) {
+    	ReleaseTerms(source->GetTermIds(index));
+    }
+    ++merges_completed_;
+    merging_ = false;
+    merge_cv_.notify_all();
+}
+
+void SegmentedSearchServer::MergeLoop() {
+    std::unique_lock lock(segments_mutex_);
+    while (true) {
+    	merge_cv_.wait(lock, [this] {
+    		return stopping_ || (!merging_ && !PickMerge().empty());
+    	});
+    	if (stopping_) {
+    		return;
+    	}
+    	const std::vector<std::shared_ptr<IndexSegment>> sources = PickMerge();
+    	merging_ = true;
+    	Merge(lock, sources);
+    }
+}
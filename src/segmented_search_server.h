@@ -0,0 +1,466 @@
+#pragma once
+
+#include "document.h"
+#include "index_segment.h"
+#include "search_context.h"
+#include "search_server.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <execution>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct SegmentedIndexOptions {
+    // documents in the mutable segment before it is frozen
+    size_t max_hot_documents = 4096;
+    // segments of one size tier that are merged into one
+    size_t merge_factor = 4;
+    // merge on a background thread, otherwise inside AddDocument
+    bool background_merges = true;
+};
+
+struct SegmentStats {
+    size_t hot_documents = 0;
+    // live documents of every frozen segment
+    std::vector<size_t> segment_documents;
+    size_t merges_completed = 0;
+};
+
+struct ApproximateQueryOptions {
+    // postings scored over all terms of all frozen segments
+    size_t max_postings = 65536;
+    // frozen segments not started within this time are skipped, zero for no limit; a query still being parsed
+    // at the deadline returns nothing with estimated_recall 0
+    std::chrono::microseconds max_duration{0};
+};
+
+struct ApproximateDocuments {
+    // relevance is summed over the scored postings only
+    std::vector<Document> documents;
+    size_t scored_postings = 0;
+    size_t total_postings = 0;
+    // share of the exact top documents proven to be among the returned ones, a lower bound of recall
+    double estimated_recall = 1.0;
+};
+
+// LSM-style index: fresh documents go to a small mutable segment, which is frozen into an immutable
+// IndexSegment once full; segments of the same size tier are merged in the background. Queries fan out
+// over all segments with IDF from global statistics, so results match a SearchServer with the same documents,
+// to the last bit when built with -ffp-contract=off as the readme requires.
+// Like SearchServer, queries may run concurrently with each other but not with AddDocument or RemoveDocument
+class SegmentedSearchServer {
+public:
+    template <typename StringContainer>
+    explicit SegmentedSearchServer(const StringContainer& stop_words, const SegmentedIndexOptions& options = {})
+    : SegmentedSearchServer(std::make_shared<SearchContext>(stop_words), options)
+    {
+    }
+
+    explicit SegmentedSearchServer(const std::string_view& stop_words_text, const SegmentedIndexOptions& options = {});
+    explicit SegmentedSearchServer(const std::string& stop_words_text, const SegmentedIndexOptions& options = {});
+    explicit SegmentedSearchServer(std::shared_ptr<SearchContext> context, const SegmentedIndexOptions& options = {});
+
+    SegmentedSearchServer(const SegmentedSearchServer&) = delete;
+    SegmentedSearchServer& operator=(const SegmentedSearchServer&) = delete;
+
+    ~SegmentedSearchServer();
+
+    void AddDocument(int document_id, const std::string_view& document, DocumentStatus status, const std::vector<int>& ratings);
+    void RemoveDocument(int document_id);
+
+    template <typename DocumentPredicate, typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, const std::string_view& raw_query,
+    		DocumentPredicate document_predicate) const {
+        const ResolvedQuery query = ResolveQuery(context_->ParseQuery(raw_query));
+        if (query.plus_terms.empty()) {
+            return {};
+        }
+        const std::vector<std::shared_ptr<IndexSegment>>& segments = query.segments;
+
+        // the last task scores the mutable segment
+        std::vector<std::vector<Document>> segment_documents(segments.size() + 1);
+        std::vector<size_t> indexes(segment_documents.size());
+        std::iota(indexes.begin(), indexes.end(), 0);
+        std::for_each(policy, indexes.begin(), indexes.end(), [&](size_t index) {
+            segment_documents[index] = index < segments.size()
+            		? ScoreSegment(*segments[index], query, document_predicate)
+            		: ScoreHotSegment(query, document_predicate);
+        });
+
+        std::vector<Document> matched_documents;
+        for (const std::vector<Document>& documents : segment_documents) {
+            matched_documents.insert(matched_documents.end(), documents.begin(), documents.end());
+        }
+        const size_t top_count = std::min<size_t>(MAX_RESULT_DOCUMENT_COUNT, matched_documents.size());
+        std::partial_sort(matched_documents.begin(), matched_documents.begin() + top_count, matched_documents.end(),
+        		IsRankedBefore);
+        matched_documents.resize(top_count);
+        return matched_documents;
+    }
+
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(const std::string_view& raw_query, DocumentPredicate document_predicate) const {
+        return FindTopDocuments(std::execution::seq, raw_query, document_predicate);
+    }
+
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, const std::string_view& raw_query, DocumentStatus status) const {
+        return FindTopDocuments(std::forward<ExecutionPolicy>(policy), raw_query, [status](int, DocumentStatus document_status, int) {
+            return document_status == status;
+        });
+    }
+
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, const std::string_view& raw_query) const {
+        return FindTopDocuments(std::forward<ExecutionPolicy>(policy), raw_query, DocumentStatus::ACTUAL);
+    }
+
+    std::vector<Document> FindTopDocuments(const std::string_view& raw_query, DocumentStatus status) const;
+    std::vector<Document> FindTopDocuments(const std::string_view& raw_query) const;
+
+    // Scores only the highest impact prefix of every posting list within the budget, so latency does not grow
+    // with the frequency of query terms. Results equal FindTopDocuments when the budget covers all postings
+    template <typename DocumentPredicate>
+    ApproximateDocuments FindTopDocumentsApproximate(const std::string_view& raw_query, DocumentPredicate document_predicate,
+    		const ApproximateQueryOptions& options) const {
+        const auto start = std::chrono::steady_clock::now();
+        const auto is_past_deadline = [&options, start]() {
+            return options.max_duration.count() > 0 && std::chrono::steady_clock::now() - start >= options.max_duration;
+        };
+        const SearchQuery parsed_query = context_->ParseQuery(raw_query);
+        ApproximateDocuments result;
+        if (is_past_deadline()) {
+            result.estimated_recall = 0.0;
+            return result;
+        }
+        const ResolvedQuery query = ResolveQuery(parsed_query);
+        if (query.plus_terms.empty()) {
+            return result;
+        }
+        const std::vector<std::shared_ptr<IndexSegment>>& segments = query.segments;
+        const size_t term_count = query.plus_terms.size();
+
+        std::vector<size_t> list_sizes(segments.size() * term_count);
+        for (size_t segment = 0; segment < segments.size(); ++segment) {
+            for (size_t term = 0; term < term_count; ++term) {
+                list_sizes[segment * term_count + term] =
+                		segments[segment]->GetPostings(query.plus_terms[term].id).documents.size();
+            }
+        }
+        std::vector<size_t> quotas = list_sizes;
+        DistributePostingBudget(quotas, options.max_postings);
+
+        // the mutable segment is small and always scored whole
+        std::vector<ApproximateCandidate> candidates;
+        for (const Document& document : ScoreHotSegment(query, document_predicate)) {
+            candidates.push_back({document, document.relevance, true});
+        }
+        for (const QueryTerm& term : query.plus_terms) {
+            if (const auto it = hot_postings_.find(term.id); it != hot_postings_.end()) {
+                result.scored_postings += it->second.size();
+                result.total_postings += it->second.size();
+            }
+        }
+
+        // best relevance a document missing from candidates could have
+        double outside_bound = -std::numeric_limits<double>::infinity();
+        for (size_t segment = 0; segment < segments.size(); ++segment) {
+            const std::span<size_t> segment_quotas(quotas.data() + segment * term_count, term_count);
+            if (is_past_deadline()) {
+                std::fill(segment_quotas.begin(), segment_quotas.end(), 0);
+            }
+            double unseen_bound = 0.0;
+            for (ApproximateCandidate& candidate : ScoreSegmentPrefix(*segments[segment], query, document_predicate,
+            		segment_quotas, unseen_bound)) {
+                candidates.push_back(std::move(candidate));
+            }
+            for (size_t term = 0; term < term_count; ++term) {
+                result.scored_postings += segment_quotas[term];
+                result.total_postings += list_sizes[segment * term_count + term];
+            }
+            if (!std::equal(segment_quotas.begin(), segment_quotas.end(), list_sizes.begin() + segment * term_count)) {
+                outside_bound = std::max(outside_bound, unseen_bound);
+            }
+        }
+
+        const size_t top_count = std::min<size_t>(MAX_RESULT_DOCUMENT_COUNT, candidates.size());
+        std::partial_sort(candidates.begin(), candidates.begin() + top_count, candidates.end(),
+        		[](const ApproximateCandidate& lhs, const ApproximateCandidate& rhs) {
+            return IsRankedBefore(lhs.document, rhs.document);
+        });
+        // a fully scored document is already ranked exactly
+        for (auto it = candidates.begin() + top_count; it != candidates.end(); ++it) {
+            if (!it->fully_scored) {
+                outside_bound = std::max(outside_bound, it->upper_bound);
+            }
+        }
+
+        size_t proven_count = 0;
+        for (size_t i = 0; i < top_count; ++i) {
+            result.documents.push_back(candidates[i].document);
+            proven_count += candidates[i].document.relevance - outside_bound >= 1e-6;
+        }
+        // while some document may be missing, the exact top is assumed to be full
+        const size_t exact_count = outside_bound == -std::numeric_limits<double>::infinity()
+        		? top_count : MAX_RESULT_DOCUMENT_COUNT;
+        result.estimated_recall = exact_count == 0 ? 1.0 : proven_count * 1.0 / exact_count;
+        return result;
+    }
+
+    ApproximateDocuments FindTopDocumentsApproximate(const std::string_view& raw_query, DocumentStatus status,
+    		const ApproximateQueryOptions& options = {}) const;
+    ApproximateDocuments FindTopDocumentsApproximate(const std::string_view& raw_query,
+    		const ApproximateQueryOptions& options = {}) const;
+
+    // Throws std::out_of_range for an unknown document
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::string_view& raw_query, int document_id) const;
+
+    int GetDocumentCount() const;
+
+    // Freezes the mutable segment now
+    void Flush();
+    // Returns once no merge is running or due
+    void WaitForMerges();
+    // Merges all frozen segments into one, dropping removed documents
+    void ForceMerge();
+    SegmentStats GetSegmentStats() const;
+
+private:
+    struct HotDocument {
+        int rating;
+        DocumentStatus status;
+        std::vector<int> term_ids;
+        std::vector<double> term_freqs;
+    };
+    struct HotPosting {
+        int document_id;
+        double term_freq;
+    };
+    struct QueryTerm {
+        std::string_view word;
+        int id;
+        double inverse_document_freq;
+    };
+    struct ApproximateCandidate {
+        Document document;
+        // relevance the document would have with all postings scored
+        double upper_bound;
+        // seen in the scored prefix of every truncated term, so relevance is final; tracked apart from
+        // upper_bound, whose sums round differently from relevance
+        bool fully_scored;
+    };
+    struct ApproximateScore {
+        double relevance = 0.0;
+        // impact bounds of the truncated terms the document was scored for
+        double seen_bound = 0.0;
+        size_t truncated_terms_seen = 0;
+    };
+    struct ResolvedQuery {
+        std::vector<std::shared_ptr<IndexSegment>> segments;
+        // in ascending document frequency like the SearchServer planner, so relevance sums match it exactly
+        // as long as no tf * idf below is contracted into a fused multiply-add (-ffp-contract=off)
+        std::vector<QueryTerm> plus_terms;
+        std::vector<int> minus_term_ids;
+    };
+
+    std::shared_ptr<SearchContext> context_;
+    SegmentedIndexOptions options_;
+    int document_count_ = 0;
+
+    std::map<int, HotDocument> hot_documents_;
+    std::unordered_map<int, std::vector<HotPosting>> hot_postings_;
+
+    mutable std::mutex segments_mutex_;
+    std::condition_variable merge_cv_;
+    std::vector<std::shared_ptr<IndexSegment>> segments_;
+    bool merging_ = false;
+    bool stopping_ = false;
+    size_t merges_completed_ = 0;
+    std::thread merge_thread_;
+
+    ResolvedQuery ResolveQuery(const SearchQuery& query) const;
+    bool ContainsDocument(int document_id) const;
+    void FreezeHotSegment();
+    void ReleaseTerms(std::span<const int> term_ids);
+    static int ComputeAverageRating(const std::vector<int>& ratings);
+    // Shrinks list sizes to quotas summing to at most budget: lists shorter than an even share are scored whole
+    static void DistributePostingBudget(std::vector<size_t>& quotas, size_t budget);
+
+    // The following are called with segments_mutex_ held.
+    // Segments due for a merge, empty if none
+    std::vector<std::shared_ptr<IndexSegment>> PickMerge() const;
+    // Wakes the merge thread or merges inline
+    void ScheduleMerges(std::unique_lock<std::mutex>& lock);
+    // Rebuilds sources into one segment with the lock released while building
+    void Merge(std::unique_lock<std::mutex>& lock, const std::vector<std::shared_ptr<IndexSegment>>& sources);
+    void MergeLoop();
+    size_t GetTier(size_t document_count) const;
+
+    template <typename DocumentPredicate>
+    std::vector<Document> ScoreSegment(const IndexSegment& segment, const ResolvedQuery& query,
+    		DocumentPredicate document_predicate) const {
+        std::vector<uint32_t> excluded;
+        for (const int term_id : query.minus_term_ids) {
+            const auto documents = segment.GetPostings(term_id).documents;
+            excluded.insert(excluded.end(), documents.begin(), documents.end());
+        }
+        std::sort(excluded.begin(), excluded.end());
+
+        const auto is_candidate = [&](uint32_t index) {
+            return !segment.IsDeleted(index)
+            		&& !std::binary_search(excluded.begin(), excluded.end(), index)
+            		&& document_predicate(segment.GetDocumentId(index), segment.GetStatus(index), segment.GetRating(index));
+        };
+
+        size_t posting_count = 0;
+        for (const QueryTerm& term : query.plus_terms) {
+            posting_count += segment.GetPostings(term.id).documents.size();
+        }
+        std::vector<Document> matched_documents;
+        if (posting_count * DENSE_SCORES_MAX_SLOTS_PER_POSTING >= segment.GetDocumentCount()) {
+            std::vector<double> scores(segment.GetDocumentCount(), 0.0);
+            std::vector<uint8_t> matched(segment.GetDocumentCount(), 0);
+            for (const QueryTerm& term : query.plus_terms) {
+                const IndexSegment::Postings postings = segment.GetPostings(term.id);
+                for (size_t i = 0; i < postings.documents.size(); ++i) {
+                    scores[postings.documents[i]] += postings.term_freqs[i] * term.inverse_document_freq;
+                    matched[postings.documents[i]] = 1;
+                }
+            }
+            for (uint32_t index = 0; index < scores.size(); ++index) {
+                if (matched[index] && is_candidate(index)) {
+                    matched_documents.push_back({segment.GetDocumentId(index), scores[index], segment.GetRating(index)});
+                }
+            }
+        } else {
+            std::map<uint32_t, double> scores;
+            for (const QueryTerm& term : query.plus_terms) {
+                const IndexSegment::Postings postings = segment.GetPostings(term.id);
+                for (size_t i = 0; i < postings.documents.size(); ++i) {
+                    scores[postings.documents[i]] += postings.term_freqs[i] * term.inverse_document_freq;
+                }
+            }
+            for (const auto& [index, relevance] : scores) {
+                if (is_candidate(index)) {
+                    matched_documents.push_back({segment.GetDocumentId(index), relevance, segment.GetRating(index)});
+                }
+            }
+        }
+        return matched_documents;
+    }
+
+    // Scores the first quotas[i] postings of every plus term. unseen_bound receives the highest relevance
+    // a document of the segment could have without appearing in any scored prefix
+    template <typename DocumentPredicate>
+    std::vector<ApproximateCandidate> ScoreSegmentPrefix(const IndexSegment& segment, const ResolvedQuery& query,
+    		DocumentPredicate document_predicate, std::span<const size_t> quotas, double& unseen_bound) const {
+        // postings are in impact order, so the first unscored posting bounds the rest of its list
+        std::vector<double> cut_bounds(query.plus_terms.size(), 0.0);
+        std::vector<uint8_t> truncated(query.plus_terms.size(), 0);
+        unseen_bound = 0.0;
+        for (size_t term = 0; term < query.plus_terms.size(); ++term) {
+            const IndexSegment::Postings postings = segment.GetPostings(query.plus_terms[term].id);
+            if (quotas[term] < postings.documents.size()) {
+                cut_bounds[term] = postings.term_freqs[quotas[term]] * query.plus_terms[term].inverse_document_freq;
+                unseen_bound += cut_bounds[term];
+                truncated[term] = 1;
+            }
+        }
+        const size_t truncated_count = std::count(truncated.begin(), truncated.end(), 1);
+
+        std::vector<ApproximateCandidate> candidates;
+        const auto add_candidate = [&](uint32_t index, const ApproximateScore& score) {
+            if (segment.IsDeleted(index)) {
+                return;
+            }
+            const std::span<const int> term_ids = segment.GetTermIds(index);
+            const bool has_minus_word = std::any_of(query.minus_term_ids.begin(), query.minus_term_ids.end(), [term_ids](int term_id) {
+                return std::binary_search(term_ids.begin(), term_ids.end(), term_id);
+            });
+            if (!has_minus_word && document_predicate(segment.GetDocumentId(index), segment.GetStatus(index), segment.GetRating(index))) {
+                const bool fully_scored = score.truncated_terms_seen == truncated_count;
+                candidates.push_back({{segment.GetDocumentId(index), score.relevance, segment.GetRating(index)},
+                		fully_scored ? score.relevance : score.relevance + unseen_bound - score.seen_bound, fully_scored});
+            }
+        };
+        const auto accumulate = [&](auto& scores) {
+            for (size_t term = 0; term < query.plus_terms.size(); ++term) {
+                const IndexSegment::Postings postings = segment.GetPostings(query.plus_terms[term].id);
+                for (size_t i = 0; i < quotas[term]; ++i) {
+                    ApproximateScore& score = scores[postings.documents[i]];
+                    score.relevance += postings.term_freqs[i] * query.plus_terms[term].inverse_document_freq;
+                    score.seen_bound += cut_bounds[term];
+                    score.truncated_terms_seen += truncated[term];
+                }
+            }
+        };
+
+        const size_t posting_count = std::accumulate(quotas.begin(), quotas.end(), size_t{0});
+        if (posting_count * DENSE_SCORES_MAX_SLOTS_PER_POSTING >= segment.GetDocumentCount()) {
+            std::vector<ApproximateScore> scores(segment.GetDocumentCount());
+            std::vector<uint8_t> matched(segment.GetDocumentCount(), 0);
+            for (size_t term = 0; term < query.plus_terms.size(); ++term) {
+                const auto documents = segment.GetPostings(query.plus_terms[term].id).documents;
+                for (size_t i = 0; i < quotas[term]; ++i) {
+                    matched[documents[i]] = 1;
+                }
+            }
+            accumulate(scores);
+            for (uint32_t index = 0; index < scores.size(); ++index) {
+                if (matched[index]) {
+                    add_candidate(index, scores[index]);
+                }
+            }
+        } else {
+            std::unordered_map<uint32_t, ApproximateScore> scores;
+            scores.reserve(posting_count);
+            accumulate(scores);
+            for (const auto& [index, score] : scores) {
+                add_candidate(index, score);
+            }
+        }
+        return candidates;
+    }
+
+    template <typename DocumentPredicate>
+    std::vector<Document> ScoreHotSegment(const ResolvedQuery& query, DocumentPredicate document_predicate) const {
+        std::map<int, double> scores;
+        for (const QueryTerm& term : query.plus_terms) {
+            const auto it = hot_postings_.find(term.id);
+            if (it == hot_postings_.end()) {
+                continue;
+            }
+            for (const HotPosting& posting : it->second) {
+                scores[posting.document_id] += posting.term_freq * term.inverse_document_freq;
+            }
+        }
+
+        std::vector<Document> matched_documents;
+        for (const auto& [document_id, relevance] : scores) {
+            const HotDocument& document = hot_documents_.at(document_id);
+            const bool has_minus_word = std::any_of(query.minus_term_ids.begin(), query.minus_term_ids.end(), [&document](int term_id) {
+                return std::binary_search(document.term_ids.begin(), document.term_ids.end(), term_id);
+            });
+            if (!has_minus_word && document_predicate(document_id, document.status, document.rating)) {
+                matched_documents.push_back({document_id, relevance, document.rating});
+            }
+        }
+        return matched_documents;
+    }
+};
@@ -0,0 +1,116 @@
+#include "stop_word_set.h"
+
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+
+StopWordSet::StopWordSet(const std::set<std::string, std::less<>>& words)
+	: words_(words.begin(), words.end())
+{
+    if (words_.empty()) {
+    	return;
+    }
+    // two slots per word keep the displacement search short, four words per bucket on average
+    slot_mask_ = std::bit_ceil(words_.size() * 2) - 1;
+    bucket_mask_ = std::bit_ceil(std::max<size_t>(words_.size() / 4, 1)) - 1;
+    for (const std::string& word : words_) {
+    	length_mask_ |= GetLengthBit(word.size());
+    }
+    for (int attempt = 0; !TryBuild(); ++attempt) {
+    	if (attempt == 64) {
+    		throw std::runtime_error("failed to build stop word hash");
+    	}
+    	seed_ = Mix(seed_ + 1);
+    }
+}
+
+uint64_t StopWordSet::GetSeed() const {
+    return seed_;
+}
+
+bool StopWordSet::Contains(std::string_view word) const {
+    return Contains(word, Hash(seed_, word));
+}
+
+bool StopWordSet::Contains(std::string_view word, uint64_t hash) const {
+    if ((length_mask_ & GetLengthBit(word.size())) == 0) {
+    	return false;
+    }
+    const uint32_t index = slots_[GetSlot(hash)];
+    return index != EMPTY_SLOT && words_[index] == word;
+}
+
+size_t StopWordSet::size() const {
+    return words_.size();
+}
+
+bool StopWordSet::empty() const {
+    return words_.empty();
+}
+
+const std::vector<std::string>& StopWordSet::GetWords() const {
+    return words_;
+}
+
+uint64_t StopWordSet::Mix(uint64_t value) {
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccdULL;
+    value ^= value >> 33;
+    return value;
+}
+
+uint64_t StopWordSet::GetLengthBit(size_t length) {
+    return uint64_t{1} << std::min<size_t>(length, 63);
+}
+
+size_t StopWordSet::GetSlot(uint64_t hash) const {
+    return Mix(hash + displacements_[(hash >> 40) & bucket_mask_]) & slot_mask_;
+}
+
+bool StopWordSet::TryBuild() {
+    std::vector<uint64_t> hashes;
+    hashes.reserve(words_.size());
+    std::vector<std::vector<uint32_t>> buckets(bucket_mask_ + 1);
+    for (uint32_t index = 0; index < words_.size(); ++index) {
+    	hashes.push_back(Hash(seed_, words_[index]));
+    	buckets[(hashes.back() >> 40) & bucket_mask_].push_back(index);
+    }
+    std::vector<uint32_t> order(buckets.size());
+    for (uint32_t bucket = 0; bucket < buckets.size(); ++bucket) {
+    	order[bucket] = bucket;
+    }
+    // the largest buckets are placed first while the table is still empty
+    std::stable_sort(order.begin(), order.end(), [&buckets](uint32_t lhs, uint32_t rhs) {
+    	return buckets[lhs].size() > buckets[rhs].size();
+    });
+
+    displacements_.assign(buckets.size(), 0);
+    slots_.assign(slot_mask_ + 1, EMPTY_SLOT);
+    std::vector<size_t> placed;
+    for (const uint32_t bucket : order) {
+    	bool fits = false;
+    	for (uint32_t displacement = 0; !fits && displacement < (1u << 16); ++displacement) {
+    		displacements_[bucket] = displacement;
+    		placed.clear();
+    		fits = true;
+    		for (const uint32_t index : buckets[bucket]) {
+    			const size_t slot = GetSlot(hashes[index]);
+    			if (slots_[slot] != EMPTY_SLOT) {
+    				fits = false;
+    				break;
+    			}
+    			slots_[slot] = index;
+    			placed.push_back(slot);
+    		}
+    		if (!fits) {
+    			for (const size_t slot : placed) {
+    				slots_[slot] = EMPTY_SLOT;
+    			}
+    		}
+    	}
+    	if (!fits) {
+    		return false;
+    	}
+    }
+    return true;
+}
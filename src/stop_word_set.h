@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Immutable set of stop words behind a perfect hash: a lookup is one hash over the word and one
+// comparison with the only stored word it can be. The hash is a running FNV-1a, so a tokenizer
+// can compute it while scanning for the end of the word and pass it to Contains
+class StopWordSet {
+public:
+    static constexpr uint64_t HashStep(uint64_t hash, char c) {
+        return (hash ^ static_cast<unsigned char>(c)) * 0x100000001b3ULL;
+    }
+
+    static constexpr uint64_t Hash(uint64_t seed, std::string_view word) {
+        for (const char c : word) {
+            seed = HashStep(seed, c);
+        }
+        return seed;
+    }
+
+    StopWordSet() = default;
+    explicit StopWordSet(const std::set<std::string, std::less<>>& words);
+
+    // Start value of the running hash
+    uint64_t GetSeed() const;
+    bool Contains(std::string_view word) const;
+    // hash must be Hash(GetSeed(), word)
+    bool Contains(std::string_view word, uint64_t hash) const;
+
+    size_t size() const;
+    bool empty() const;
+    // In lexicographic order
+    const std::vector<std::string>& GetWords() const;
+
+private:
+    static constexpr uint32_t EMPTY_SLOT = UINT32_MAX;
+
+    std::vector<std::string> words_;
+    // displacement of each bucket chosen so that the words of all buckets land in distinct slots
+    std::vector<uint32_t> displacements_;
+    std::vector<uint32_t> slots_;
+    uint64_t seed_ = 0xcbf29ce484222325ULL;
+    uint64_t bucket_mask_ = 0;
+    uint64_t slot_mask_ = 0;
+    // bit n is set when some word has length n, longer words share bit 63
+    uint64_t length_mask_ = 0;
+
+    static uint64_t Mix(uint64_t value);
+    static uint64_t GetLengthBit(size_t length);
+    size_t GetSlot(uint64_t hash) const;
+    bool TryBuild();
+};
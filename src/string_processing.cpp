@@ -1,5 +1,7 @@
 #include "string_processing.h"
 
+#include <algorithm>
+
 std::vector<std::string> SplitIntoWords(const std::string_view& text) {
     std::vector<std::string> words;
     std::string word;
@@ -36,3 +38,9 @@ std::vector<std::string_view> SplitIntoWordsView(std::string_view text) {
 
     return result;
 }
+
+bool IsValidWord(const std::string_view& word) {
+    return std::none_of(word.begin(), word.end(), [](char c) {
+        return c >= '\0' && c < ' ';
+    });
+}
@@ -9,6 +9,9 @@ std::vector<std::string> SplitIntoWords(const std::string_view& text);
 
 std::vector<std::string_view> SplitIntoWordsView(std::string_view text);
 
+// A word is valid when it has no control characters
+bool IsValidWord(const std::string_view& word);
+
 template <typename StringContainer>
 std::set<std::string, std::less<>> MakeUniqueNonEmptyStrings(const StringContainer& strings) {
     std::set<std::string, std::less<>> non_empty_strings;
@@ -1,5 +1,6 @@
 #include "test_example_functions.h"
 
+#include <execution>
 #include <iostream>
 
 void AddDocument(SearchServer& search_server, int document_id, const std::string_view& document, DocumentStatus status,
@@ -40,9 +41,11 @@ void FindTopDocuments(const SearchServer& search_server, const std::string_view&
 void MatchDocuments(const SearchServer& search_server, const std::string_view& query) {
     try {
         std::cout << "Document matching on query: " << query << std::endl;
-        for (const auto& document_id : search_server) {
-            const auto [words, status] = search_server.MatchDocument(query, document_id);
-            PrintMatchDocumentResult(document_id, words, status);
+        const std::vector<int> document_ids(search_server.begin(), search_server.end());
+        const MatchedDocuments matched = search_server.MatchDocuments(std::execution::par, query, document_ids);
+        for (size_t i = 0; i < matched.size(); ++i) {
+            const auto words = matched.GetWords(i);
+            PrintMatchDocumentResult(matched.document_ids[i], {words.begin(), words.end()}, matched.statuses[i]);
         }
     } catch (const std::exception& e) {
         std::cout << "Document matching error " << query << ": " << e.what() << std::endl;
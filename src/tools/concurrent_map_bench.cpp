@@ -0,0 +1,166 @@
+#include "../concurrent_map.h"
+
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+// ConcurrentMap before it was sharded into open addressing tables: one std::map behind a mutex per bucket
+template<typename Key, typename Value>
+class PreviousConcurrentMap {
+	public:
+		struct Bucket {
+			mutex mutex_;
+			map<Key, Value> map_;
+		};
+
+		struct Access {
+			Access(const Key& key, Bucket& bucket)
+				: lock_guard(bucket.mutex_)
+				, ref_to_value(bucket.map_[key])
+			{
+			}
+			std::lock_guard<mutex> lock_guard;
+			Value& ref_to_value;
+		};
+
+		explicit PreviousConcurrentMap(size_t bucket_count)
+			: buckets_(bucket_count)
+		{
+		}
+
+		Access operator[](const Key& key) {
+			return Access{key, buckets_[static_cast<uint64_t>(key) % buckets_.size()]};
+		}
+
+		map<Key, Value> BuildOrdinaryMap() {
+			map<Key, Value> ordinary_map;
+			for (auto& [mutex_, map_] : buckets_) {
+				std::lock_guard<mutex> lock_(mutex_);
+				ordinary_map.insert(map_.begin(), map_.end());
+			}
+			return ordinary_map;
+		}
+
+	private:
+		vector<Bucket> buckets_;
+};
+
+void PrintUsage() {
+    cerr << "usage: concurrent_map_bench [--threads COUNT]... [--keys COUNT] [--operations COUNT] [--buckets COUNT]"s << endl;
+}
+
+// Same key sequence for every map: thread t visits keys of a xorshift stream seeded by t
+int NextKey(uint64_t& state, size_t key_count) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return static_cast<int>(state % key_count);
+}
+
+// Runs operation(key) operation_count times on each of thread_count threads, returns operations per second
+template <typename Operation>
+double MeasureThroughput(size_t thread_count, size_t key_count, size_t operation_count, Operation operation) {
+    vector<thread> threads;
+    threads.reserve(thread_count);
+    const auto start = chrono::steady_clock::now();
+    for (size_t t = 0; t < thread_count; ++t) {
+    	threads.emplace_back([&, t]() {
+    		uint64_t state = 0x9e3779b97f4a7c15ULL * (t + 1);
+    		for (size_t i = 0; i < operation_count; ++i) {
+    			operation(NextKey(state, key_count));
+    		}
+    	});
+    }
+    for (thread& worker : threads) {
+    	worker.join();
+    }
+    const chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    return static_cast<double>(thread_count * operation_count) / elapsed.count();
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    vector<size_t> thread_counts;
+    size_t key_count = 100000;
+    size_t operation_count = 1000000;
+    size_t bucket_count = 4;
+    try {
+    	for (int i = 1; i < argc; ++i) {
+    		const string argument = argv[i];
+    		if (i + 1 == argc) {
+    			PrintUsage();
+    			return 2;
+    		}
+    		const string value = argv[++i];
+    		if (argument == "--threads"s) {
+    			thread_counts.push_back(max<size_t>(1, stoul(value)));
+    		} else if (argument == "--keys"s) {
+    			key_count = max<size_t>(1, stoul(value));
+    		} else if (argument == "--operations"s) {
+    			operation_count = stoul(value);
+    		} else if (argument == "--buckets"s) {
+    			bucket_count = max<size_t>(1, stoul(value));
+    		} else {
+    			PrintUsage();
+    			return 2;
+    		}
+    	}
+    } catch (const logic_error&) {
+    	PrintUsage();
+    	return 2;
+    }
+    if (thread_counts.empty()) {
+    	const size_t hardware_threads = max(1u, thread::hardware_concurrency());
+    	for (size_t count = 1; count < hardware_threads; count *= 2) {
+    		thread_counts.push_back(count);
+    	}
+    	thread_counts.push_back(hardware_threads);
+    }
+
+    // every operation adds 1.0, so all three maps must end with the same exact counts
+    cout << "keys "s << key_count << ", operations per thread "s << operation_count
+    		<< ", previous map buckets "s << bucket_count << endl;
+    cout << setw(8) << "threads"s << setw(16) << "previous op/s"s << setw(16) << "operator[] op/s"s
+    		<< setw(16) << "Add op/s"s << endl;
+    bool mismatch = false;
+    for (const size_t thread_count : thread_counts) {
+    	PreviousConcurrentMap<int, double> previous(bucket_count);
+    	const double previous_rate = MeasureThroughput(thread_count, key_count, operation_count, [&](int key) {
+    		previous[key].ref_to_value += 1.0;
+    	});
+
+    	ConcurrentMap<int, double> accessed;
+    	const double access_rate = MeasureThroughput(thread_count, key_count, operation_count, [&](int key) {
+    		accessed[key].ref_to_value += 1.0;
+    	});
+
+    	ConcurrentMap<int, double> added;
+    	const double add_rate = MeasureThroughput(thread_count, key_count, operation_count, [&](int key) {
+    		added.Add(key, 1.0);
+    	});
+
+    	const map<int, double> expected = previous.BuildOrdinaryMap();
+    	if (accessed.BuildOrdinaryMap() != expected || added.BuildOrdinaryMap() != expected) {
+    		mismatch = true;
+    	}
+    	cout << fixed << setprecision(0) << setw(8) << thread_count << setw(16) << previous_rate
+    			<< setw(16) << access_rate << setw(16) << add_rate << endl;
+    }
+    if (mismatch) {
+    	cerr << "maps disagree on the final counts"s << endl;
+    	return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,190 @@
+#include "../scoring_kernels.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+const size_t TERM_COUNT = 8;
+
+void PrintUsage() {
+    cerr << "usage: scoring_bench [--documents COUNT] [--postings COUNT] [--rounds COUNT]"s << endl;
+}
+
+struct Term {
+    vector<uint32_t> slots;
+    vector<double> term_freqs;
+    double inverse_document_freq = 0.0;
+};
+
+struct KernelOutput {
+    vector<double> scores;
+    vector<double> maxima;
+    vector<uint32_t> candidates;
+};
+
+struct KernelTimings {
+    double postings_per_second = 0.0;
+    double maxima_scores_per_second = 0.0;
+    double collect_scores_per_second = 0.0;
+};
+
+// Posting lists of distinct random slots with term frequencies like count / document length
+vector<Term> MakeTerms(size_t document_count, size_t posting_count) {
+    mt19937_64 random(42);
+    vector<uint32_t> all_slots(document_count);
+    iota(all_slots.begin(), all_slots.end(), 0);
+    uniform_int_distribution<int> length(1, 200);
+    uniform_real_distribution<double> idf(0.01, 12.0);
+    vector<Term> terms(TERM_COUNT);
+    for (size_t i = 0; i < TERM_COUNT; ++i) {
+    	Term& term = terms[i];
+    	shuffle(all_slots.begin(), all_slots.end(), random);
+    	// lengths differ by one between terms, so every tail length of the vector loops is exercised
+    	const size_t length_limit = posting_count > i ? posting_count - i : 1;
+    	term.slots.assign(all_slots.begin(), all_slots.begin() + min(length_limit, document_count));
+    	term.term_freqs.resize(term.slots.size());
+    	for (double& term_freq : term.term_freqs) {
+    		term_freq = static_cast<double>(length(random) % 7 + 1) / length(random);
+    	}
+    	term.inverse_document_freq = idf(random);
+    }
+    return terms;
+}
+
+template <typename Function>
+double MeasureSeconds(Function function) {
+    const auto start = chrono::steady_clock::now();
+    function();
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// Runs every kernel of the active instruction set, keeps the outputs of the last round for comparison
+KernelTimings RunKernels(const vector<Term>& terms, size_t document_count, size_t rounds, KernelOutput& output) {
+    KernelTimings timings;
+    size_t posting_total = 0;
+    const double accumulate_seconds = MeasureSeconds([&]() {
+    	for (size_t round = 0; round < rounds; ++round) {
+    		output.scores.assign(document_count, 0.0);
+    		for (const Term& term : terms) {
+    			AccumulateScores(output.scores.data(), term.slots.data(), term.term_freqs.data(), term.slots.size(),
+    					term.inverse_document_freq);
+    			posting_total += term.slots.size();
+    		}
+    	}
+    });
+    timings.postings_per_second = posting_total / accumulate_seconds;
+
+    output.maxima.assign((document_count + SCORING_BLOCK_SIZE - 1) / SCORING_BLOCK_SIZE, 0.0);
+    const double maxima_seconds = MeasureSeconds([&]() {
+    	for (size_t round = 0; round < rounds; ++round) {
+    		ComputeBlockMaxima(output.scores.data(), document_count, output.maxima.data());
+    	}
+    });
+    timings.maxima_scores_per_second = document_count * rounds / maxima_seconds;
+
+    vector<uint8_t> matched(document_count);
+    for (size_t slot = 0; slot < document_count; ++slot) {
+    	matched[slot] = slot % 3 != 0;
+    }
+    vector<double> sorted_scores = output.scores;
+    nth_element(sorted_scores.begin(), sorted_scores.begin() + document_count * 9 / 10, sorted_scores.end());
+    const double threshold = sorted_scores[document_count * 9 / 10];
+    output.candidates.resize(document_count);
+    size_t found = 0;
+    const double collect_seconds = MeasureSeconds([&]() {
+    	for (size_t round = 0; round < rounds; ++round) {
+    		found = CollectCandidates(output.scores.data(), matched.data(), document_count, threshold, output.candidates.data());
+    	}
+    });
+    output.candidates.resize(found);
+    timings.collect_scores_per_second = document_count * rounds / collect_seconds;
+    return timings;
+}
+
+bool IsBitIdentical(const KernelOutput& lhs, const KernelOutput& rhs) {
+    return lhs.scores.size() == rhs.scores.size()
+    		&& memcmp(lhs.scores.data(), rhs.scores.data(), lhs.scores.size() * sizeof(double)) == 0
+    		&& lhs.maxima.size() == rhs.maxima.size()
+    		&& memcmp(lhs.maxima.data(), rhs.maxima.data(), lhs.maxima.size() * sizeof(double)) == 0
+    		&& lhs.candidates == rhs.candidates;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    size_t document_count = 1000003;
+    size_t posting_count = 1 << 16;
+    size_t rounds = 50;
+    try {
+    	for (int i = 1; i < argc; ++i) {
+    		const string argument = argv[i];
+    		if (i + 1 == argc) {
+    			PrintUsage();
+    			return 2;
+    		}
+    		const string value = argv[++i];
+    		if (argument == "--documents"s) {
+    			document_count = max<size_t>(1, stoul(value));
+    		} else if (argument == "--postings"s) {
+    			posting_count = max<size_t>(1, stoul(value));
+    		} else if (argument == "--rounds"s) {
+    			rounds = max<size_t>(1, stoul(value));
+    		} else {
+    			PrintUsage();
+    			return 2;
+    		}
+    	}
+    } catch (const logic_error&) {
+    	PrintUsage();
+    	return 2;
+    }
+
+    const vector<Term> terms = MakeTerms(document_count, posting_count);
+    const ScoringIsa best_isa = GetBestScoringIsa();
+    cout << "documents "s << document_count << ", postings per term "s << terms.front().slots.size()
+    		<< ", terms "s << TERM_COUNT << ", rounds "s << rounds << endl;
+    cout << setw(8) << "isa"s << setw(16) << "postings/s"s << setw(16) << "maxima/s"s
+    		<< setw(16) << "collect/s"s << setw(12) << "vs scalar"s << endl;
+
+    // every variant must reproduce the scalar kernels bit for bit, including the tails shorter than a vector
+    KernelOutput scalar_output;
+    bool mismatch = false;
+    for (const ScoringIsa isa : {ScoringIsa::SCALAR, ScoringIsa::AVX2, ScoringIsa::AVX512}) {
+    	try {
+    		SetScoringIsa(isa);
+    	} catch (const invalid_argument&) {
+    		cout << setw(8) << GetScoringIsaName(isa) << "  not supported by this CPU"s << endl;
+    		continue;
+    	}
+    	KernelOutput output;
+    	const KernelTimings timings = RunKernels(terms, document_count, rounds, output);
+    	bool identical = true;
+    	if (isa == ScoringIsa::SCALAR) {
+    		scalar_output = move(output);
+    	} else {
+    		identical = IsBitIdentical(output, scalar_output);
+    		mismatch = mismatch || !identical;
+    	}
+    	cout << fixed << setprecision(0) << setw(8) << GetScoringIsaName(isa) << setw(16) << timings.postings_per_second
+    			<< setw(16) << timings.maxima_scores_per_second << setw(16) << timings.collect_scores_per_second
+    			<< setw(12) << (identical ? "identical"s : "DIFFERS"s) << endl;
+    }
+    SetScoringIsa(best_isa);
+    if (mismatch) {
+    	cerr << "an instruction set does not reproduce the scalar kernels bit for bit"s << endl;
+    	return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,157 @@
+#include "../search_client.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+void PrintUsage() {
+    cerr << "usage: search_loadgen (--unix PATH | --port PORT) [--connections COUNT] [--depth COUNT]"s
+    		<< " [--requests COUNT] [--queries FILE]"s << endl;
+}
+
+// Keeps depth FindTopDocuments requests in flight on one connection and records each round trip
+void RunConnection(SearchClient& client, const vector<string>& queries, size_t next_query, size_t depth,
+		atomic<size_t>& remaining, atomic<size_t>& errors, vector<double>& latencies_us) {
+    deque<chrono::steady_clock::time_point> sent;
+    const auto send_one = [&]() {
+    	size_t available = remaining.load(memory_order_relaxed);
+    	while (available > 0 && !remaining.compare_exchange_weak(available, available - 1, memory_order_relaxed)) {
+    	}
+    	if (available == 0) {
+    		return false;
+    	}
+    	SearchRequest request;
+    	request.opcode = SearchOpcode::FIND_TOP_DOCUMENTS;
+    	request.text = queries[next_query++ % queries.size()];
+    	client.Send(move(request));
+    	sent.push_back(chrono::steady_clock::now());
+    	return true;
+    };
+
+    for (size_t i = 0; i < depth && send_one(); ++i) {
+    }
+    while (!sent.empty()) {
+    	const SearchResponse response = client.Receive();
+    	const auto now = chrono::steady_clock::now();
+    	latencies_us.push_back(chrono::duration<double, micro>(now - sent.front()).count());
+    	sent.pop_front();
+    	if (!response.error.empty()) {
+    		errors.fetch_add(1, memory_order_relaxed);
+    	}
+    	send_one();
+    }
+}
+
+double Percentile(const vector<double>& sorted, double fraction) {
+    if (sorted.empty()) {
+    	return 0.0;
+    }
+    return sorted[min(sorted.size() - 1, static_cast<size_t>(fraction * sorted.size()))];
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    string unix_path;
+    int tcp_port = -1;
+    size_t connection_count = 4;
+    size_t depth = 16;
+    size_t request_count = 100000;
+    vector<string> queries;
+    try {
+    	for (int i = 1; i < argc; ++i) {
+    		const string argument = argv[i];
+    		if (i + 1 == argc) {
+    			PrintUsage();
+    			return 2;
+    		}
+    		const string value = argv[++i];
+    		if (argument == "--unix"s) {
+    			unix_path = value;
+    		} else if (argument == "--port"s) {
+    			tcp_port = stoi(value);
+    		} else if (argument == "--connections"s) {
+    			connection_count = max<size_t>(1, stoul(value));
+    		} else if (argument == "--depth"s) {
+    			depth = max<size_t>(1, stoul(value));
+    		} else if (argument == "--requests"s) {
+    			request_count = stoul(value);
+    		} else if (argument == "--queries"s) {
+    			ifstream input(value);
+    			for (string line; getline(input, line); ) {
+    				if (!line.empty()) {
+    					queries.push_back(line);
+    				}
+    			}
+    		} else {
+    			PrintUsage();
+    			return 2;
+    		}
+    	}
+    } catch (const logic_error&) {
+    	PrintUsage();
+    	return 2;
+    }
+    if (unix_path.empty() == (tcp_port < 0)) {
+    	PrintUsage();
+    	return 2;
+    }
+    if (queries.empty()) {
+    	queries = {"curly cat"s, "nasty dog -tail"s, "white hat"s, "big eyes pigeon"s};
+    }
+
+    try {
+    	vector<unique_ptr<SearchClient>> clients;
+    	for (size_t i = 0; i < connection_count; ++i) {
+    		clients.push_back(unix_path.empty() ? make_unique<SearchClient>(static_cast<uint16_t>(tcp_port))
+    				: make_unique<SearchClient>(unix_path));
+    	}
+    	atomic<size_t> remaining = request_count;
+    	atomic<size_t> errors = 0;
+    	vector<vector<double>> latencies(connection_count);
+    	for (size_t i = 0; i < connection_count; ++i) {
+    		latencies[i].reserve(request_count / connection_count + depth);
+    	}
+
+    	const auto start = chrono::steady_clock::now();
+    	vector<thread> threads;
+    	for (size_t i = 0; i < connection_count; ++i) {
+    		threads.emplace_back([&, i]() {
+    			RunConnection(*clients[i], queries, i * queries.size() / connection_count, depth, remaining, errors, latencies[i]);
+    		});
+    	}
+    	for (thread& t : threads) {
+    		t.join();
+    	}
+    	const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    	vector<double> all_latencies;
+    	for (const vector<double>& connection_latencies : latencies) {
+    		all_latencies.insert(all_latencies.end(), connection_latencies.begin(), connection_latencies.end());
+    	}
+    	sort(all_latencies.begin(), all_latencies.end());
+    	cout << fixed << setprecision(1)
+    			<< "requests "s << all_latencies.size() << ", errors "s << errors.load() << ", "s
+    			<< all_latencies.size() / seconds << " requests/s"s << endl
+    			<< "latency us: p50 "s << Percentile(all_latencies, 0.5) << ", p90 "s << Percentile(all_latencies, 0.9)
+    			<< ", p99 "s << Percentile(all_latencies, 0.99) << ", p99.9 "s << Percentile(all_latencies, 0.999)
+    			<< ", max "s << (all_latencies.empty() ? 0.0 : all_latencies.back()) << endl;
+    } catch (const exception& e) {
+    	cerr << "search_loadgen: "s << e.what() << endl;
+    	return 1;
+    }
+    return 0;
+}
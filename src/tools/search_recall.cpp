@@ -0,0 +1,92 @@
+#include "../approximate_recall.h"
+
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+void PrintUsage() {
+    cerr << "usage: search_recall --corpus FILE --queries FILE [--stop-words WORDS] [--budget POSTINGS]..."s << endl;
+}
+
+vector<string> ReadLines(const string& path) {
+    ifstream input(path);
+    if (!input) {
+    	throw runtime_error("cannot open "s + path);
+    }
+    vector<string> lines;
+    for (string line; getline(input, line); ) {
+    	lines.push_back(line);
+    }
+    return lines;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    string corpus_path;
+    string queries_path;
+    string stop_words;
+    vector<size_t> budgets;
+    try {
+    	for (int i = 1; i < argc; ++i) {
+    		const string argument = argv[i];
+    		if (i + 1 == argc) {
+    			PrintUsage();
+    			return 2;
+    		}
+    		const string value = argv[++i];
+    		if (argument == "--corpus"s) {
+    			corpus_path = value;
+    		} else if (argument == "--queries"s) {
+    			queries_path = value;
+    		} else if (argument == "--stop-words"s) {
+    			stop_words = value;
+    		} else if (argument == "--budget"s) {
+    			budgets.push_back(stoul(value));
+    		} else {
+    			PrintUsage();
+    			return 2;
+    		}
+    	}
+    } catch (const logic_error&) {
+    	PrintUsage();
+    	return 2;
+    }
+    if (corpus_path.empty() || queries_path.empty()) {
+    	PrintUsage();
+    	return 2;
+    }
+    if (budgets.empty()) {
+    	budgets = {1000, 10000, 100000};
+    }
+
+    try {
+    	// documents of the corpus are lines, ids are line numbers like CorpusFormat::LINES
+    	SegmentedSearchServer search_server(stop_words);
+    	const vector<string> documents = ReadLines(corpus_path);
+    	for (size_t id = 0; id < documents.size(); ++id) {
+    		try {
+    			search_server.AddDocument(static_cast<int>(id), documents[id], DocumentStatus::ACTUAL, {});
+    		} catch (const invalid_argument&) {
+    		}
+    	}
+    	search_server.WaitForMerges();
+    	const vector<string> queries = ReadLines(queries_path);
+    	cout << "documents = "s << search_server.GetDocumentCount() << endl;
+    	for (const size_t budget : budgets) {
+    		ApproximateQueryOptions options;
+    		options.max_postings = budget;
+    		cout << "budget = "s << budget << ": "s << EvaluateApproximateRecall(search_server, queries, options) << endl;
+    	}
+    } catch (const exception& e) {
+    	cerr << e.what() << endl;
+    	return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,117 @@
+#include "../corpus_loader.h"
+#include "../index_log.h"
+#include "../search_daemon.h"
+#include "../search_server.h"
+
+#include <csignal>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+namespace {
+
+SearchDaemon* running_daemon = nullptr;
+
+void HandleSignal(int) {
+    if (running_daemon != nullptr) {
+    	running_daemon->Stop();
+    }
+}
+
+void PrintUsage() {
+    cerr << "usage: searchserverd (--unix PATH | --port PORT) [--stop-words WORDS] [--corpus FILE] [--format lines|tsv]"s
+    		<< " [--log DIRECTORY] [--batch SIZE]"s << endl;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    SearchDaemonOptions options;
+    string stop_words;
+    string corpus_path;
+    string log_directory;
+    CorpusFormat format = CorpusFormat::LINES;
+    bool has_address = false;
+    try {
+    	for (int i = 1; i < argc; ++i) {
+    		const string argument = argv[i];
+    		if (i + 1 == argc) {
+    			PrintUsage();
+    			return 2;
+    		}
+    		const string value = argv[++i];
+    		if (argument == "--unix"s) {
+    			options.unix_path = value;
+    			has_address = true;
+    		} else if (argument == "--port"s) {
+    			options.tcp_port = static_cast<uint16_t>(stoul(value));
+    			has_address = true;
+    		} else if (argument == "--stop-words"s) {
+    			stop_words = value;
+    		} else if (argument == "--corpus"s) {
+    			corpus_path = value;
+    		} else if (argument == "--format"s) {
+    			format = value == "tsv"s ? CorpusFormat::TSV : CorpusFormat::LINES;
+    		} else if (argument == "--log"s) {
+    			log_directory = value;
+    		} else if (argument == "--batch"s) {
+    			options.max_batch_size = stoul(value);
+    		} else {
+    			PrintUsage();
+    			return 2;
+    		}
+    	}
+    } catch (const logic_error&) {
+    	PrintUsage();
+    	return 2;
+    }
+    if (!has_address) {
+    	PrintUsage();
+    	return 2;
+    }
+
+    try {
+    	SearchServer search_server(stop_words);
+    	unique_ptr<IndexLog> index_log;
+    	if (!log_directory.empty()) {
+    		index_log = make_unique<IndexLog>(log_directory);
+    		const RecoveryStats stats = index_log->Recover(search_server);
+    		cerr << "recovered "s << stats.checkpoint_documents << " documents and "s << stats.log_records_applied
+    				<< " log records"s << endl;
+    	}
+    	if (!corpus_path.empty() && search_server.GetDocumentCount() == 0) {
+    		const CorpusLoadStats stats = LoadCorpusFromFile(search_server, corpus_path, format);
+    		cerr << "loaded "s << stats.documents_added << " documents, rejected "s << stats.lines_rejected << " lines"s << endl;
+    		if (index_log) {
+    			index_log->Checkpoint(search_server);
+    		}
+    	}
+
+    	SearchDaemon daemon(search_server, options, index_log.get());
+    	running_daemon = &daemon;
+    	signal(SIGINT, HandleSignal);
+    	signal(SIGTERM, HandleSignal);
+    	if (options.unix_path.empty()) {
+    		cerr << "listening on 127.0.0.1:"s << daemon.GetTcpPort() << endl;
+    	} else {
+    		cerr << "listening on "s << options.unix_path << endl;
+    	}
+    	daemon.Run();
+    	running_daemon = nullptr;
+
+    	const SearchDaemonStats stats = daemon.GetStats();
+    	cerr << "served "s << stats.requests_served << " requests in "s << stats.batches_executed << " batches over "s
+    			<< stats.connections_accepted << " connections, "s << stats.protocol_errors << " protocol errors"s << endl;
+    	if (index_log) {
+    		index_log->Checkpoint(search_server);
+    	}
+    } catch (const exception& e) {
+    	cerr << "searchserverd: "s << e.what() << endl;
+    	return 1;
+    }
+    return 0;
+}